@@ -0,0 +1,13 @@
+# cmake -DEXPECTED=<vm_bench> -DACTUAL=<vm_bench> -DCYCLES=<cycles per ROM> "-DROMS=<ROM> <ROM>..." -P compare_hashes.cmake
+# runs both builds of vm_bench on the same ROMs and fails unless they print the same final state hashes
+separate_arguments(ROMS UNIX_COMMAND "${ROMS}")
+foreach(bench EXPECTED ACTUAL)
+    execute_process(COMMAND ${${bench}} ${CYCLES} ${ROMS} RESULT_VARIABLE result OUTPUT_VARIABLE ${bench}_HASHES)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "${${bench}} failed (${result})")
+    endif()
+endforeach()
+if (NOT EXPECTED_HASHES STREQUAL ACTUAL_HASHES)
+    message(FATAL_ERROR "The final states differ\n${EXPECTED}:\n${EXPECTED_HASHES}\n${ACTUAL}:\n${ACTUAL_HASHES}")
+endif()
+message("${ACTUAL_HASHES}")
@@ -0,0 +1,44 @@
+// upscale_bench - per-frame cost of the CPU-side upscaling filters at large window scale factors
+// Usage : upscale_bench [frames per measurement, default 200]
+#include "../include/Upscaler.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+inline constexpr unsigned display_width { 64 }, display_height { 32 };
+
+int main(int argc, char** argv) {
+    const unsigned frames { argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : 200u };
+    // a random frame has edges everywhere, which is the worst case for the edge filters
+    std::vector<uint8_t> frame(display_width * display_height);
+    std::mt19937 rng { 1337 };
+    for (auto &px : frame) {
+        px = rng() & 0x1u;
+    }
+    const std::pair<const char*, ScaleFilter> filters[] {
+        { "nearest", ScaleFilter::nearest },
+        { "scale2x", ScaleFilter::scale2x },
+        { "scale3x", ScaleFilter::scale3x },
+        { "smooth", ScaleFilter::smooth },
+        { "scanline", ScaleFilter::scanline }
+    };
+    printf("%-10s %-6s %-12s %-10s %s\n", "filter", "scale", "window", "isa", "us/frame");
+    for (const unsigned scale : { 10u, 16u, 30u }) {
+        for (const auto &[name, filter] : filters) {
+            Upscaler upscaler { display_width, display_height, scale, filter };
+            std::vector<uint32_t> pixels(upscaler.out_width() * upscaler.out_height());
+            upscaler.upscale(frame.data(), pixels.data()); // warm up the caches
+            const auto start { std::chrono::steady_clock::now() };
+            for (unsigned idx {}; idx < frames; idx++) {
+                upscaler.upscale(frame.data(), pixels.data());
+            }
+            const std::chrono::duration<double, std::micro> elapsed { std::chrono::steady_clock::now() - start };
+            char window[16] {};
+            snprintf(window, sizeof(window), "%ux%u", upscaler.out_width(), upscaler.out_height());
+            printf("%-10s x%-5u %-12s %-10s %.1f\n", name, scale, window, upscaler.isa(), elapsed.count() / frames);
+        }
+    }
+    return EXIT_SUCCESS;
+}
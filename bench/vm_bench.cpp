@@ -0,0 +1,72 @@
+// vm_bench - emulation speed of the VM core on ROMs, built once per dispatch variant (interpreter, ahead-of-time translated, specialized)
+// Usage : vm_bench <cycles per ROM> <ROM>...
+// Prints a hash of the final VM state per ROM to stdout (identical for every variant, the CTests compare them) and the time per
+// emulated CPU cycle to stderr. The keys are pressed one after another, each held for a second of emulated time.
+#include "../include/VmPool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// FNV-1a over the architectural state, memory and display
+static uint64_t state_hash(const VmPool &pool, const VmPool::vm_id id) {
+    uint64_t hash { 0xcbf29ce484222325ull };
+    const auto mix { [&hash](const uint8_t byte) { hash = (hash ^ byte) * 0x100000001b3ull; } };
+    const Chip8::CpuState &cpu { pool.cpu_state(id) };
+    for (const uint8_t v : cpu.reg.V) {
+        mix(v);
+    }
+    for (const uint16_t word : { cpu.reg.I, cpu.reg.pc }) {
+        mix(word >> 8);
+        mix(word & 0xff);
+    }
+    for (const uint16_t word : cpu.stack) {
+        mix(word >> 8);
+        mix(word & 0xff);
+    }
+    for (const uint8_t byte : { cpu.reg.sp, cpu.timer.delay, cpu.timer.sound, cpu.timers_phase, static_cast<uint8_t>(cpu.fault) }) {
+        mix(byte);
+    }
+    for (unsigned addr {}; addr < memory_size; addr++) {
+        mix(pool.peek(id, addr));
+    }
+    for (const auto &row : pool.display(id)) {
+        for (const uint8_t px : row) {
+            mix(px);
+        }
+    }
+    return hash;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage : %s <cycles per ROM> <ROM>...\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const unsigned long cycles { std::strtoul(argv[1], nullptr, 10) };
+    for (int arg { 2 }; arg < argc; arg++) {
+        FILE *rom_file { fopen(argv[arg], "rb") };
+        if (!rom_file) {
+            fprintf(stderr, "ROM '%s' is not found\n", argv[arg]);
+            exit(EXIT_FAILURE);
+        }
+        std::vector<uint8_t> rom(memory_size);
+        rom.resize(fread(rom.data(), 1, rom.size(), rom_file));
+        fclose(rom_file);
+        VmPool pool { rom.data(), rom.size() };
+        const VmPool::vm_id id { pool.fork(0) };
+        const auto start { std::chrono::steady_clock::now() };
+        for (unsigned long done {}, second {}; done < cycles; done += cpu_frequency, second++) {
+            // a fault is a part of the final state as well
+            if (pool.run(id, std::min<unsigned long>(cpu_frequency, cycles - done), 1u << (second % keypad_size)) != Fault::none) {
+                break;
+            }
+        }
+        const std::chrono::duration<double, std::nano> elapsed { std::chrono::steady_clock::now() - start };
+        const char *name { std::strrchr(argv[arg], '/') ? std::strrchr(argv[arg], '/') + 1 : argv[arg] };
+        printf("%-10s %016llx\n", name, static_cast<unsigned long long>(state_hash(pool, id)));
+        fprintf(stderr, "%-10s %.2f ns/cycle\n", name, elapsed.count() / cycles);
+    }
+    return EXIT_SUCCESS;
+}
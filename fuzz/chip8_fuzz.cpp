@@ -0,0 +1,25 @@
+// chip8_fuzz - libFuzzer target, every input is loaded as a ROM and emulated for a bounded amount of CPU cycles
+// Usage : chip8_fuzz [libFuzzer options] [corpus directory, e.g. ../ROMs]
+// The VM is built headless and constructed once, each input starts from a copy of its pristine state.
+// Faults of malformed ROMs are regular results, only crashes and sanitizer reports are findings.
+#include "../include/Chip8.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// about half a second of emulated time at 500 Hz, most malformed inputs fault or settle into a loop well before
+inline constexpr unsigned fuzz_cycles { 256 };
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static Chip8 vm;
+    static const Chip8::Snapshot pristine { [] {
+        Chip8::Snapshot snapshot;
+        vm.save_snapshot(snapshot);
+        return snapshot;
+    }() };
+    vm.restore_snapshot(pristine);
+    if (!vm.load_image(data, size)) {
+        return 0;
+    }
+    vm.run_cycles(fuzz_cycles);
+    return 0;
+}
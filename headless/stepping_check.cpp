@@ -0,0 +1,57 @@
+// stepping_check - runs ROMs on VmPool once in a single run() call and once split into shorter calls,
+// the resulting states must be identical (the timers phase is carried over between the calls)
+#include "../include/VmPool.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct SteppingCase {
+    const char *name;
+    std::vector<uint8_t> rom;
+    unsigned cycles;
+    uint16_t keys;
+};
+
+static bool same_state(const VmPool &pool, const VmPool::vm_id lhs, const VmPool::vm_id rhs) {
+    const Chip8::CpuState &a { pool.cpu_state(lhs) }, &b { pool.cpu_state(rhs) };
+    if (a.reg.V != b.reg.V || a.reg.I != b.reg.I || a.reg.pc != b.reg.pc || a.reg.sp != b.reg.sp || a.stack != b.stack ||
+        a.timer.delay != b.timer.delay || a.timer.sound != b.timer.sound || a.key_wait.active != b.key_wait.active ||
+        a.key_wait.reg != b.key_wait.reg || a.timers_phase != b.timers_phase || a.fault != b.fault) {
+        return false;
+    }
+    for (unsigned addr {}; addr < memory_size; addr++) {
+        if (pool.peek(lhs, addr) != pool.peek(rhs, addr)) {
+            return false;
+        }
+    }
+    return pool.display(lhs) == pool.display(rhs);
+}
+
+int main() {
+    const std::vector<SteppingCase> cases {
+        // LD V1, 0x20; LD DT, V1; delay timer busy wait (fast-forwarded); JP self
+        { "delay wait", { 0x61, 0x20, 0xf1, 0x15, 0xf0, 0x07, 0x30, 0x00, 0x12, 0x04, 0x12, 0x0a }, 40, 0 },
+        // LD V1, 0x05; LD DT, V1; LD V0, K with no key held - the timers keep running while suspended
+        { "key wait", { 0x61, 0x05, 0xf1, 0x15, 0xf0, 0x0a, 0x12, 0x06 }, 16, 0 },
+        // LD V1, 0x03; LD DT, V1; LD V0, K with key 5 held; LD F, V0; DRW V0, V0, 5; LD B, V1 at I = 0x300; JP self
+        { "key press", { 0x61, 0x03, 0xf1, 0x15, 0xf0, 0x0a, 0xf0, 0x29, 0xd0, 0x05, 0xa3, 0x00, 0xf1, 0x33, 0x12, 0x0e }, 64, 1u << 5 }
+    };
+    int status { EXIT_SUCCESS };
+    for (const SteppingCase &test : cases) {
+        for (const unsigned step : { 1u, 2u, 3u, 5u, 7u, 8u, 13u }) {
+            VmPool pool { test.rom.data(), test.rom.size() };
+            const VmPool::vm_id whole { pool.fork(0) }, stepped { pool.fork(0) };
+            pool.run(whole, test.cycles, test.keys);
+            for (unsigned done {}; done < test.cycles; done += step) {
+                pool.run(stepped, std::min(step, test.cycles - done), test.keys);
+            }
+            if (!same_state(pool, whole, stepped)) {
+                fprintf(stderr, "%s : %u cycles in steps of %u differ from a single run (pc 0x%x/0x%x, DT %u/%u, timers phase %u/%u)\n", test.name, test.cycles, step,
+                        pool.cpu_state(whole).reg.pc, pool.cpu_state(stepped).reg.pc, pool.cpu_state(whole).timer.delay, pool.cpu_state(stepped).timer.delay,
+                        pool.cpu_state(whole).timers_phase, pool.cpu_state(stepped).timers_phase);
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    return status;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+class Chip8;
+
+// a straight-line block of guest code translated ahead-of-time by the chip8aot tool (tools/chip8_aot.cpp)
+struct AotBlock {
+    uint16_t addr; // address of the first instruction of the block
+    uint16_t length; // amount of guest instructions (CPU cycles) in the block
+    // translated code, runs the instructions [first, last) of the block (indices, not addresses) and leaves reg.pc at the next
+    // instruction to be executed, so the block can be entered in the middle and cut short at a timers update
+    void (*fn)(Chip8&, const unsigned, const unsigned) noexcept;
+};
+
+// all the symbols below are defined by the generated translation unit
+extern const AotBlock aot_blocks[];
+extern const uint16_t aot_block_count;
+// the ROM image the blocks have been translated from, compared against the loaded ROM before the blocks are used
+extern const uint8_t aot_rom_image[];
+extern const uint16_t aot_rom_size;
@@ -3,10 +3,32 @@
 #include <stdint.h>
 #include <string>
 #include <random>
+#include <array>
+#ifndef CHIP8_HEADLESS
 #include <SFML/Audio.hpp>
 #include "Graphics.hpp"
+#include "Metrics.hpp"
+#endif
+#include "RomPack.hpp"
+#include "SharedFrame.hpp"
+#include <memory>
+#include <utility>
+#ifdef CHIP8_PROFILER
+#include "Profiler.hpp"
+#endif
+#ifdef CHIP8_DEBUGGER
+#ifdef CHIP8_HEADLESS
+#error "the debugger needs the window, it can't be built headless"
+#endif
+#include "Debugger.hpp"
+#endif
+#ifdef CHIP8_AOT
+#include "Aot.hpp"
+#include <bitset>
+#endif
 
-inline constexpr uint16_t memory_size          { 4096 };
+inline constexpr uint16_t memory_size          { 4096 },
+                          memory_page_size     { 256 }; // granularity of the dirty memory tracking (see VmPool.hpp)
 inline constexpr uint8_t stack_size            { 16 },
                          display_width         { 64 },
                          display_height        { 32 },
@@ -26,17 +48,60 @@ inline constexpr unsigned timers_frequency     { 60 }, // original timers freque
 // instruction execution time = 2 ms for 500 Hz CPU
 inline constexpr float instruction_time { (1.f / static_cast<float>(cpu_frequency)) * 1000.f }; 
 
+// reason the CPU has stopped, malformed ROMs are reported through it instead of terminating the process
+enum class Fault : uint8_t {
+    none,
+    stack_overflow,
+    stack_underflow,
+    illegal_instruction,
+    memory_out_of_bounds // instruction fetch, sprite read or LD B / LD [I] / LD Vx, [I] past the end of memory
+};
+
 class Chip8 {
     public:
-        explicit Chip8(const std::string&, const std::string&, const uint8_t, const std::string&);
+        // registers, stack, keypad, timers and the rest of the small state, copied member-wise (see the definitions below the class)
+        struct CpuState;
+        // complete VM state - memory, display and CpuState
+        struct Snapshot;
+#ifdef CHIP8_HEADLESS
+        // no window, sound or keyboard - the VM is driven by load_image() and run_cycles() only (fuzzing, batch tools)
+        explicit Chip8();
+#else
+        // if a ROM pack is passed, the first argument is the name of the ROM inside of the pack
+        explicit Chip8(const std::string&, const std::string&, const uint8_t, const std::string&, const ScaleFilter = ScaleFilter::nearest, const RomPack* = nullptr);
+        // returns when the window is closed or the CPU faults
+        Fault run() noexcept; 
+        // rewrite a Prometheus text file with the runtime metrics every second
+        void export_metrics(const std::string&);
+#endif
         ~Chip8() = default;
-        void run() noexcept; 
+        // publish the display, registers and keypad to a POSIX shared memory segment once per frame (every timers update of run() or
+        // run_cycles()) and accept keypad input from it
+        void export_shared_frame(const std::string&);
+#ifdef CHIP8_DEBUGGER
+        // serve a GDB client on 127.0.0.1:<port>, blocks until it connects
+        void attach_debugger(const uint16_t);
+#endif
+        // copies a ROM image to the load address on top of the current memory, returns false if it doesn't fit
+        bool load_image(const uint8_t*, const size_t) noexcept;
+        // the same for a ROM of a pack, its quirk profile is applied as well, returns false if there is no such ROM in the pack,
+        // it doesn't fit or its image doesn't match the hash it was packed with
+        bool load_image(const RomPack&, const std::string&) noexcept;
+        // emulates exactly the given amount of CPU cycles at full speed with the timers running, stops early on a fault or
+        // in LD Vx, K with the timers run out - splitting the amount over several calls gives the same state
+        Fault run_cycles(unsigned) noexcept;
+        void save_snapshot(Snapshot&) const noexcept;
+        void restore_snapshot(const Snapshot&) noexcept;
+        void save_cpu_state(CpuState&) const noexcept;
+        void restore_cpu_state(const CpuState&) noexcept;
     private:
         std::array<uint8_t, memory_size> memory; // Chip-8 memory space
         std::array<std::array<uint8_t, display_width>, display_height> display; // 64-wide 32-height display (will be scaled by the scale factor in actual window)
+#ifndef CHIP8_HEADLESS
         Graphics gfx_obj;
         sf::SoundBuffer sound_buffer;
-        const std::array<uint8_t, fontset_size> font_sprites;
+#endif
+        static const std::array<uint8_t, fontset_size> font_sprites;
         // this anonymous struct represents all Chip-8 registers
         struct {
             std::array<uint8_t, general_reg_arr_size> V; // general purpose registers
@@ -44,16 +109,27 @@ class Chip8 {
             uint16_t pc; // program counter
             uint8_t sp; // stack pointer
         } reg;
+#ifndef CHIP8_HEADLESS
         sf::Sound beep;
+        Metrics metrics;
+        bool overlay_visible; // the metrics are drawn over the frame, toggled with Tab
+#endif
         std::array<uint16_t, stack_size> stack; 
         std::array<uint8_t, keypad_size> keypad;
         uint16_t instruction, nnn, rom_size;
         const uint16_t rom_load_addr;
+        uint8_t quirks; // quirk profile of the loaded ROM (quirk_* bits from RomPack.hpp)
+        Fault fault; // set by the instruction routines, the CPU doesn't execute anything until it is cleared
+        uint16_t dirty_pages; // one bit per memory page written since VmPool last cleared it
+        bool display_dirty; // the display has been drawn or cleared since VmPool last cleared it
         // Chip-8 timers, decremented at the rate of 60 Hz
         struct {
             uint8_t delay, sound;
         } timer;
+        uint8_t timers_phase; // CPU cycles run_cycles() has emulated since the last timers update
         // extremely thin random byte generator wrapper class 
+        // every VM owns its engine and the engine state is a part of CpuState, so a restored snapshot or a forked VmPool state
+        // replays the same RND results - headless builds also start from a fixed seed, so fuzzer findings reproduce across runs
         class RandomByteGenerator {
             public:
                 explicit RandomByteGenerator();
@@ -61,9 +137,25 @@ class Chip8 {
                 uint8_t randbyte() noexcept;
             private:
                 std::uniform_int_distribution<uint8_t> byte_distribution;
-                inline static std::default_random_engine rand_gen { std::random_device()() };
+                std::default_random_engine rand_gen;
         };
         RandomByteGenerator rand_byte_gen;
+        // LD Vx, K suspends the CPU until a key is pressed, the timers keep running meanwhile
+        struct {
+            bool active;
+            uint8_t reg; // index of Vx that receives the pressed key
+        } key_wait;
+        std::unique_ptr<SharedFrame> shared_frame; // nullptr unless the frame is exported
+        uint16_t shared_input_keys; // last keypad input read from the shared frame
+#ifdef CHIP8_PROFILER
+        Profiler profiler;
+        std::string profile_prefix; // file name of the ROM (the ROM name for a pack), the profile is written to <prefix>.folded and <prefix>.hot.txt
+#endif
+        friend class VmPool;
+#ifdef CHIP8_DEBUGGER
+        friend class Debugger;
+        std::unique_ptr<Debugger> debugger; // nullptr unless a GDB client is attached
+#endif
         uint8_t x, y, n, kk, opcode;
         // jump tables for instruction decoding routine
         // global_jt is a master jump table
@@ -72,6 +164,16 @@ class Chip8 {
         static void(Chip8::*const subtable_op_8_jt[subtable_op_8_size])();
         static void(Chip8::*const subtable_op_e_jt[subtable_op_e_size])();
         static void(Chip8::*const subtable_op_f_jt[subtable_op_f_size])();
+#ifdef CHIP8_SPECIALIZED_DISPATCH
+        // alternative backend - one handler per 16-bit instruction value, indexed directly by the fetched instruction
+        using specialized_handler_t = void (*)(Chip8&) noexcept;
+        static const std::array<specialized_handler_t, 0x10000> specialized_jt;
+        template <uint16_t> static void specialized_inst(Chip8&) noexcept;
+        template <void (Chip8::*)() noexcept> static void decoded_inst(Chip8&) noexcept;
+        template <uint16_t> static constexpr specialized_handler_t select_specialized_handler() noexcept;
+        template <uint8_t, size_t... idx> static constexpr std::array<specialized_handler_t, 0x1000> make_specialized_row(std::index_sequence<idx...>) noexcept;
+        template <size_t... opcodes> static constexpr std::array<specialized_handler_t, 0x10000> make_specialized_jt(std::index_sequence<opcodes...>) noexcept;
+#endif
 
         void dispatch_0() noexcept;
         void inst_00e0() noexcept;
@@ -104,6 +206,7 @@ class Chip8 {
         void dispatch_f() noexcept;
         void inst_fx07() noexcept;
         void inst_fx0a() noexcept;
+        void resume_key_wait() noexcept;
         void inst_fx15() noexcept;
         void inst_fx18() noexcept;
         void inst_fx1e() noexcept;
@@ -115,11 +218,58 @@ class Chip8 {
         void invalid_instruction_handler() noexcept;
 
         void clear_display() noexcept;
+        void mark_dirty(const uint16_t, const uint16_t) noexcept;
         void initialize_vm();
         void load_rom(const std::string&);
+        void load_rom(const RomPack&, const std::string&);
+#ifndef CHIP8_HEADLESS
         void load_sound(const std::string&);
+#endif
+        void fetch_instruction() noexcept;
+        void decode_instruction() noexcept;
         void emulate_cpu_cycle() noexcept;
+        bool fast_paths_enabled() const noexcept;
         void update_timers() noexcept;
+        void sync_shared_frame() noexcept;
+        unsigned skip_delay_wait(const unsigned, const unsigned) noexcept;
+        void report_fault() const noexcept;
+#ifndef CHIP8_HEADLESS
         void handle_key_up(sf::Event&) noexcept;
         void handle_key_down(sf::Event&) noexcept;
+        void handle_event(sf::Event&) noexcept;
+        void refresh_overlay() noexcept;
+#endif
+#ifdef CHIP8_AOT
+        // the statically recompiled blocks (generated by tools/chip8_aot.cpp) access the VM state directly
+        friend struct AotAccess;
+        // recompiled block covering the instruction at the address (the one starting there if there are several), nullptr means
+        // that the address is interpreted
+        std::array<const AotBlock*, memory_size> aot_lookup;
+        // memory bytes covered by recompiled blocks, a write there invalidates the affected blocks
+        std::bitset<memory_size> aot_code_map;
+        void aot_init() noexcept;
+        void aot_step() noexcept;
+        unsigned aot_run_block(const unsigned) noexcept;
+        void aot_invalidate(const uint16_t, const uint16_t) noexcept;
+#endif
+};
+
+// plain copies of the architectural state, restoring one is a handful of memcpy calls (e.g. a fuzzer reset per input)
+struct Chip8::CpuState {
+    decltype(Chip8::reg) reg;
+    decltype(Chip8::stack) stack;
+    decltype(Chip8::keypad) keypad;
+    decltype(Chip8::timer) timer;
+    decltype(Chip8::key_wait) key_wait;
+    decltype(Chip8::rand_byte_gen) rand_byte_gen;
+    uint8_t timers_phase;
+    uint16_t rom_size;
+    uint8_t quirks;
+    Fault fault;
+};
+
+struct Chip8::Snapshot {
+    decltype(Chip8::memory) memory;
+    decltype(Chip8::display) display;
+    CpuState cpu;
 };
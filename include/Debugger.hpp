@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <bitset>
+#include <string>
+
+class Chip8;
+
+// GDB remote serial protocol stub, compiled into chip8vm only with -DCHIP8_DEBUGGER=ON (see CMakeLists.txt)
+// The client connects to 127.0.0.1:<port>, the register file ('g' packet) is laid out as
+// V0..VF (1 byte each), I (2 bytes, little-endian), PC (2 bytes, little-endian), SP, DT, ST (1 byte each).
+// Supported packets : ?, g, G, p, m, M, c, s, Z0/z0, Z1/z1 (pc breakpoints), Z2/z2 (memory write watchpoints), D, k, qSupported, qAttached,
+// and the interrupt byte (0x03, Ctrl-C in GDB) while the VM is running.
+class Debugger {
+    public:
+        // blocks until a GDB client connects, the VM is stopped before its first instruction
+        explicit Debugger(Chip8&, const uint16_t);
+        ~Debugger();
+        Debugger(const Debugger&) = delete;
+        Debugger& operator=(const Debugger&) = delete;
+        // a client is connected, after a detach or a dropped connection the VM runs as if no debugger had been attached
+        bool attached() const noexcept { return client_fd != -1; }
+        bool should_stop(const uint16_t) const noexcept;
+        // single step, watchpoint hit or interrupt - not a breakpoint
+        bool stop_pending() const noexcept { return stop_requested; }
+        // non-blocking check for the interrupt byte, called from the run loop while the client waits for a stop
+        void poll_interrupt() noexcept;
+        void on_memory_write(const uint16_t, const uint16_t) noexcept;
+        // reports the stop to the client and serves it until it resumes the VM
+        void stop();
+    private:
+        Chip8 &vm;
+        // one bit per byte of the Chip-8 address space
+        std::bitset<4096> breakpoints, watchpoints;
+        bool stop_requested, // single step, watchpoint hit or interrupt
+             resumed, // the client is waiting for a stop reply
+             interrupted; // the stop has been requested by the interrupt byte
+        int watch_hit; // address of the last watchpoint hit, -1 if none
+        int listen_fd, client_fd;
+        bool read_packet(std::string&);
+        void send_packet(const std::string&);
+        std::string handle_packet(const std::string&, bool&);
+        void disconnect();
+};
+
+inline bool Debugger::should_stop(const uint16_t pc) const noexcept {
+    return stop_requested || breakpoints.test(pc & 0x0fff);
+}
+
+inline void Debugger::on_memory_write(const uint16_t addr, const uint16_t len) noexcept {
+    for (uint16_t idx {}; idx < len; idx++) {
+        if (watchpoints.test((addr + idx) & 0x0fff)) {
+            stop_requested = true;
+            watch_hit = (addr + idx) & 0x0fff;
+            return;
+        }
+    }
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// returns the mnemonic of a single Chip-8 instruction (e.g. "LD V1, 0x2a"), illegal instructions are rendered as "DW 0xnnnn"
+std::string disassemble(const uint16_t instruction);
@@ -1,32 +1,47 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <algorithm>
 #include <array>
 #include <stdint.h>
+#include <string>
+#include <vector>
+#include "Upscaler.hpp"
 
 class Graphics {
     public:
-        explicit Graphics(const uint8_t, const uint8_t, const uint8_t, const std::string&);
+        explicit Graphics(const uint8_t, const uint8_t, const uint8_t, const std::string&, const ScaleFilter = ScaleFilter::nearest);
         ~Graphics() = default;
         template <uint8_t display_width, uint8_t display_height>
         void redraw_screen(const std::array<std::array<uint8_t, display_width>, display_height>&) noexcept;
+        // lines drawn over the frame in the top left corner with the given 4x5 font (5 bytes per hex digit), empty - no overlay
+        // besides the hex digits only the letters I L O P R S T U and ':' are drawn (see label_glyphs in Graphics.cpp)
+        void set_overlay(std::vector<std::string>, const uint8_t*) noexcept;
         sf::RenderWindow window;
     private:
         const uint8_t scale_factor;
+        // the frame is upscaled on the CPU into a window-sized texture, so the per-frame cost doesn't depend on the GPU
+        Upscaler upscaler;
+        std::vector<uint8_t> frame; // display flattened row by row
+        std::vector<uint32_t> pixels; // RGBA pixels of the whole window
+        sf::Texture texture;
+        sf::Sprite sprite;
+        std::vector<std::string> overlay;
+        const uint8_t *overlay_font;
+        void draw_overlay() noexcept;
 };
 
 template <uint8_t display_width, uint8_t display_height>
 inline void Graphics::redraw_screen(const std::array<std::array<uint8_t, display_width>, display_height> &display) noexcept {
-    window.clear();
-    sf::RectangleShape px(sf::Vector2f(scale_factor, scale_factor));
     for (unsigned row {}; row < display_height; row++) {
-        for (unsigned col {}; col < display_width; col++) {
-            if (display[row][col]) {
-                px.setPosition(col * scale_factor, row * scale_factor);
-                px.setFillColor(sf::Color::White);
-                window.draw(px);
-            } 
-        }
+        std::copy(display[row].begin(), display[row].end(), frame.begin() + row * display_width);
+    }
+    upscaler.upscale(frame.data(), pixels.data());
+    if (!overlay.empty()) {
+        draw_overlay();
     }
+    texture.update(reinterpret_cast<const sf::Uint8*>(pixels.data()));
+    window.clear();
+    window.draw(sprite);
     window.display();
 }
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Every metric has a single writer (the emulator thread), so the counters are updated with plain relaxed load/store pairs
+// instead of read-modify-write instructions, readers (the export thread) never block it.
+inline void metrics_add(std::atomic<uint64_t> &counter, const uint64_t value) noexcept {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Prometheus-style histogram of durations in microseconds
+class Histogram {
+    public:
+        // upper bounds of the buckets, the last bucket (+Inf) takes the rest
+        static constexpr std::array<uint32_t, 11> bounds_us { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000 };
+        void observe(const float) noexcept;
+        uint64_t count() const noexcept { return count_total.load(std::memory_order_relaxed); }
+        uint64_t sum_us() const noexcept { return sum_total_us.load(std::memory_order_relaxed); }
+        // appends the histogram in the Prometheus text format, name is the metric name without the _seconds suffix
+        void write(std::string&, const char*, const char*) const;
+    private:
+        std::array<std::atomic<uint64_t>, bounds_us.size() + 1> buckets {};
+        std::atomic<uint64_t> count_total {}, sum_total_us {};
+};
+
+// Runtime behaviour of the emulator under the host load.
+// With start_export() a background thread replaces a Prometheus text file with the current values every second.
+class Metrics {
+    public:
+        Metrics();
+        ~Metrics();
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+        void start_export(const std::string&);
+        // instructions interpreted or run by translated blocks
+        void on_instructions(const unsigned count) noexcept { metrics_add(instructions, count); }
+        // CPU cycles of LD Vx, K suspension and of fast-forwarded delay timer waits, they are paced but not emulated
+        void on_cycles_skipped(const unsigned count) noexcept { metrics_add(cycles_skipped, count); }
+        void on_frame_presented(const float latency_us) noexcept;
+        void on_sleep(const float overshoot_us) noexcept;
+        // wall time since the previous timers update, the emulated period is period_us
+        void on_timers_tick(const float, const float) noexcept;
+        void on_audio_restart() noexcept { metrics_add(audio_restarts, 1); }
+        // instructions/s, mean frame present latency, mean sleep overshoot, mean timer drift (us) since the previous call,
+        // dropped frames and audio restarts in total - one labeled number per line (e.g. "IPS:500"), for the on-screen overlay
+        std::vector<std::string> overlay_lines();
+    private:
+        std::atomic<uint64_t> instructions {}, // emulated instructions only, see on_cycles_skipped()
+                              cycles_skipped {},
+                              frames_presented {},
+                              frames_dropped {}, // 60 Hz frames the host was too late for
+                              audio_restarts {}; // beeps restarted before the previous one finished (SFML has no underrun counter)
+        Histogram frame_present, sleep_overshoot, timer_drift;
+        // totals at the previous overlay_lines() call
+        struct {
+            uint64_t instructions, present_count, present_sum, sleep_count, sleep_sum, drift_count, drift_sum;
+            std::chrono::steady_clock::time_point time;
+        } overlay_last;
+        std::string export_path;
+        std::thread exporter;
+        std::mutex exporter_mutex;
+        std::condition_variable exporter_cv;
+        bool exporter_stop {};
+        void export_loop();
+        bool write_file(const uint64_t) const;
+};
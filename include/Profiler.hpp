@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+// execution profiler, compiled into chip8vm only with -DCHIP8_PROFILER=ON (see CMakeLists.txt)
+class Profiler {
+    public:
+        explicit Profiler();
+        ~Profiler() = default;
+        void on_instruction(const uint16_t, const uint16_t, const uint64_t = 1) noexcept;
+        void on_call(const uint16_t, const uint8_t);
+        void on_return(const uint8_t);
+        // writes <prefix>.folded (collapsed stacks for flamegraph.pl / speedscope) and <prefix>.hot.txt (hot addresses and handlers)
+        void dump(const std::string&, const uint8_t*);
+    private:
+        std::array<uint64_t, 4096> pc_hits; // executions per address
+        std::vector<uint64_t> instruction_hits; // executions per instruction value, aggregated per handler in the report
+        std::vector<uint16_t> frames; // call targets mirroring the Chip-8 stack
+        std::map<std::vector<uint16_t>, uint64_t> stack_hits; // executions per call stack
+        uint64_t pending_hits; // executions in the current call stack that are not accounted in stack_hits yet
+        void flush_stack();
+};
+
+inline void Profiler::on_instruction(const uint16_t pc, const uint16_t instruction, const uint64_t count) noexcept {
+    pc_hits[pc & 0x0fff] += count;
+    instruction_hits[instruction] += count;
+    pending_hits += count;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// ROM pack layout (host byte order), built by the chip8pack tool (tools/chip8_pack.cpp):
+// RomPackHeader | RomPackEntry[rom_count] sorted by name | concatenated ROM images
+inline constexpr char rom_pack_magic[4] { 'C', '8', 'P', 'K' };
+inline constexpr uint32_t rom_pack_version { 1 };
+inline constexpr size_t rom_pack_name_size { 48 };
+
+// quirk profile bits stored per ROM
+inline constexpr uint8_t quirk_load_store_increments_i { 0x1 }; // LD [I], Vx and LD Vx, [I] leave I pointing past the last register
+
+struct RomPackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t rom_count;
+    uint32_t reserved;
+};
+
+struct RomPackEntry {
+    char name[rom_pack_name_size]; // null-terminated file name of the ROM
+    uint64_t hash; // FNV-1a hash of the image
+    uint32_t offset; // offset of the image from the beginning of the pack
+    uint16_t size;
+    uint8_t quirks;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(RomPackHeader) == 16 && sizeof(RomPackEntry) == 64, "ROM pack layout must not depend on the compiler");
+
+// read-only view of a memory-mapped ROM pack, the mapping is shared by all the VMs loading from it
+class RomPack {
+    public:
+        explicit RomPack(const std::string&);
+        ~RomPack();
+        RomPack(const RomPack&) = delete;
+        RomPack& operator=(const RomPack&) = delete;
+        // returns nullptr if there is no such ROM in the pack
+        const RomPackEntry* find(const std::string&) const noexcept;
+        const uint8_t* image(const RomPackEntry&) const noexcept;
+        // the image still matches the hash the pack was built with
+        bool intact(const RomPackEntry&) const noexcept;
+    private:
+        const uint8_t *base;
+        size_t length;
+        const RomPackHeader *header;
+        const RomPackEntry *entries;
+};
+
+uint64_t rom_hash(const uint8_t*, const size_t) noexcept;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+inline constexpr uint32_t shared_frame_magic   { 0x43384652 }, // "C8FR"
+                          shared_frame_version { 1 };
+
+// layout of the POSIX shared memory segment exported by chip8vm (-m option)
+// The emulator is the only writer and never waits for readers, consistency is provided by the sequence counter (seqlock):
+// it is odd while an update is in progress and advances by 2 with every published frame.
+struct SharedFrameLayout {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> sequence;
+    uint32_t reserved;
+    uint64_t frame; // amount of published frames (60 per second)
+    uint8_t display[32][64]; // 1 - pixel is on, 0 - pixel is off
+    uint8_t V[16];
+    uint16_t I, pc;
+    uint8_t sp, delay_timer, sound_timer;
+    uint8_t keypad[16]; // keypad as seen by the VM
+    // written by consumers, bit N set - key N is pressed, the changes are applied to the VM keypad once per frame
+    std::atomic<uint16_t> input_keys;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint16_t>::is_always_lock_free,
+              "the shared frame requires address-free atomics");
+
+// consumer side of the seqlock, the fields are read in place between these calls:
+//     uint32_t seq;
+//     do {
+//         seq = shared_frame_read_begin(*layout);
+//         ... read the frame ...
+//     } while (shared_frame_read_retry(*layout, seq));
+inline uint32_t shared_frame_read_begin(const SharedFrameLayout &layout) noexcept {
+    uint32_t seq;
+    while ((seq = layout.sequence.load(std::memory_order_acquire)) & 1) {}
+    return seq;
+}
+
+inline bool shared_frame_read_retry(const SharedFrameLayout &layout, const uint32_t seq) noexcept {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return layout.sequence.load(std::memory_order_relaxed) != seq;
+}
+
+// producer side, owns the segment and removes it on destruction
+class SharedFrame {
+    public:
+        explicit SharedFrame(const std::string&);
+        ~SharedFrame();
+        SharedFrame(const SharedFrame&) = delete;
+        SharedFrame& operator=(const SharedFrame&) = delete;
+        // the layout may be modified only between begin_update() and end_update()
+        SharedFrameLayout& begin_update() noexcept;
+        void end_update() noexcept;
+        uint16_t input_keys() const noexcept;
+    private:
+        const std::string name;
+        SharedFrameLayout *layout;
+};
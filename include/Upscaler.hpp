@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum class ScaleFilter {
+    nearest, // plain pixel blocks
+    scale2x, // Scale2x (EPX) edge rules on a 2x grid, then nearest up to the window size
+    scale3x, // Scale3x edge rules on a 3x grid
+    smooth, // Scale2x applied twice (Scale4x), the smoothest diagonals
+    scanline // nearest with the last row of every pixel darkened
+};
+
+// returns false if the name is not one of "nearest", "scale2x", "scale3x", "smooth", "scanline"
+bool parse_scale_filter(const std::string&, ScaleFilter&);
+
+// CPU-side upscaler of the 1-bit (one byte per pixel) display into the RGBA pixels of the window
+// The filters run on a small intermediate grid, the expansion into the window-sized buffer uses AVX2 or SSE2 kernels when available.
+class Upscaler {
+    public:
+        explicit Upscaler(const unsigned, const unsigned, const unsigned, const ScaleFilter);
+        ~Upscaler() = default;
+        // frame is width * height bytes (row-major), out is width * scale by height * scale RGBA pixels
+        void upscale(const uint8_t*, uint32_t*) noexcept;
+        unsigned out_width() const noexcept { return width * scale; }
+        unsigned out_height() const noexcept { return height * scale; }
+        // name of the instruction set used by the expansion kernels
+        const char* isa() const noexcept;
+        // RGBA colors in memory order (little-endian 0xAABBGGRR)
+        static constexpr uint32_t pixel_on  { 0xffffffff },
+                                  pixel_off { 0xff000000 };
+        struct Kernels {
+            const char *isa;
+            // fills one output row, grid pixel N becomes runs[N] output pixels, may write up to 8 pixels past the row end
+            void (*expand_row)(uint32_t*, const uint8_t*, const uint16_t*, const unsigned) noexcept;
+            // halves the RGB channels of a row (scanlines)
+            void (*darken_row)(uint32_t*, const uint32_t*, const unsigned) noexcept;
+        };
+    private:
+        const unsigned width, height, scale;
+        const ScaleFilter filter;
+        const unsigned grid_factor; // intermediate grid is (width * grid_factor) x (height * grid_factor)
+        std::vector<uint8_t> grid, tmp_grid;
+        std::vector<uint16_t> col_runs, row_runs; // amount of output columns/rows every grid column/row expands to
+        std::vector<uint32_t> row_buf; // one expanded row plus slack for the vector stores
+        const Kernels &kernels;
+        void build_grid(const uint8_t*) noexcept;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <stdint.h>
+#include <array>
+#include <memory>
+#include <vector>
+
+#ifndef CHIP8_HEADLESS
+#error "VmPool runs the VM states on a headless scratch Chip8, build it with CHIP8_HEADLESS"
+#endif
+
+inline constexpr uint16_t memory_page_count { memory_size / memory_page_size };
+
+// Fixed-size blocks carved out of chunks of 256, released blocks are recycled through a free list and never returned to the system.
+// Every block carries a reference count, acquire() hands it out with one reference.
+template <typename T>
+class Arena {
+    public:
+        T* acquire() {
+            if (free_list.empty()) {
+                chunks.push_back(std::make_unique<T[]>(chunk_blocks));
+                for (size_t idx { chunk_blocks }; idx > 0; idx--) {
+                    free_list.push_back(&chunks.back()[idx - 1]);
+                }
+            }
+            T *block { free_list.back() };
+            free_list.pop_back();
+            block->refs = 1;
+            return block;
+        }
+        void retain(T *block) noexcept {
+            block->refs++;
+        }
+        // returns true if the last reference is gone and the block is free again
+        bool release(T *block) {
+            if (--block->refs) {
+                return false;
+            }
+            free_list.push_back(block);
+            return true;
+        }
+        size_t in_use() const noexcept {
+            return chunks.size() * chunk_blocks - free_list.size();
+        }
+    private:
+        static constexpr size_t chunk_blocks { 256 };
+        std::vector<std::unique_ptr<T[]>> chunks;
+        std::vector<T*> free_list;
+};
+
+// Pool of VM states for fork-heavy search tools.
+// A state is a table of pointers to refcounted 256-byte memory pages and to a refcounted framebuffer, plus its Chip8::CpuState,
+// so fork() copies 17 pointers and the registers. States are executed on a single scratch Chip8 : the pages whose pointers differ
+// from the ones loaded into it last are copied in, the pages written meanwhile are copied out - in place if the state is their
+// only owner, into fresh pages otherwise (copy-on-write). The framebuffer is shared the same way until the first DRW or CLS.
+// Every id passed in must be live - returned by fork() (or the root state 0) and not released since, checked by assert() unless NDEBUG is defined.
+class VmPool {
+    public:
+        using vm_id = uint32_t;
+        using Framebuffer = std::array<std::array<uint8_t, display_width>, display_height>;
+        // the root state (id 0) is the freshly loaded ROM image
+        explicit VmPool(const uint8_t*, const size_t);
+        // the same for a ROM of a pack, with its quirk profile
+        explicit VmPool(const RomPack&, const std::string&);
+        ~VmPool() = default;
+        VmPool(const VmPool&) = delete;
+        VmPool& operator=(const VmPool&) = delete;
+        // O(1), the clone shares all of its pages and the framebuffer with the original
+        vm_id fork(const vm_id);
+        // the id is reused by a later fork()
+        void release(const vm_id);
+        // holds the keys of the mask (bit N - key N) and emulates the given amount of CPU cycles on the state
+        Fault run(const vm_id, const unsigned, const uint16_t);
+        const Chip8::CpuState& cpu_state(const vm_id) const noexcept;
+        uint8_t peek(const vm_id, const uint16_t) const noexcept;
+        const Framebuffer& display(const vm_id) const noexcept;
+        // blocks referenced by the live states, this is what the pool really occupies
+        size_t pages_in_use() const noexcept { return pages.in_use(); }
+        size_t frames_in_use() const noexcept { return frames.in_use(); }
+    private:
+        struct Page {
+            std::array<uint8_t, memory_page_size> data;
+            uint32_t refs;
+        };
+        struct Frame {
+            Framebuffer pixels;
+            uint32_t refs;
+        };
+        struct State {
+            std::array<Page*, memory_page_count> pages; // all nullptr once released
+            Frame *frame;
+            Chip8::CpuState cpu;
+        };
+        Arena<Page> pages;
+        Arena<Frame> frames;
+        std::vector<State> states;
+        std::vector<vm_id> free_ids;
+        Chip8 scratch;
+        // blocks whose contents the scratch VM holds right now
+        std::array<const Page*, memory_page_count> loaded_pages;
+        const Frame *loaded_frame;
+        void add_root_state();
+        // released states keep their slot in states with the frame pointer cleared
+        bool live(const vm_id id) const noexcept { return id < states.size() && states[id].frame; }
+        void release_page(Page*);
+        void release_frame(Frame*);
+};
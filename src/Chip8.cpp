@@ -1,10 +1,13 @@
 #include "../include/Chip8.hpp"
+#ifndef CHIP8_HEADLESS
 #include <SFML/Window/Keyboard.hpp>
+#endif
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <chrono>
 #include <thread>
 #include <ratio>
@@ -12,13 +15,19 @@
 using ms = std::chrono::milliseconds;
 using timestamp = std::chrono::high_resolution_clock;
 using float_duration_ms = std::chrono::duration<float, std::milli>;
+using float_duration_us = std::chrono::duration<float, std::micro>;
 
 inline uint8_t Chip8::RandomByteGenerator::randbyte() noexcept {
     return byte_distribution(rand_gen);
 }
 
 Chip8::RandomByteGenerator::RandomByteGenerator() 
-    : byte_distribution(std::uniform_int_distribution<uint8_t>(0, 255)) {}
+    : byte_distribution(std::uniform_int_distribution<uint8_t>(0, 255)),
+#ifdef CHIP8_HEADLESS
+      rand_gen() {} // default seed
+#else
+      rand_gen(std::random_device()()) {}
+#endif
 
 // ===================== JUMP TABLES, EACH OF THEM CONTAINS THE APPROPRIATE FUNCTION POINTER TO INSTRUCTION DECODING PROCEDURE =========================
 void (Chip8::*const Chip8::global_jt[global_jumptable_size])() = {
@@ -199,32 +208,63 @@ void (Chip8::*const Chip8::subtable_op_f_jt[subtable_op_f_size])() = {
     &Chip8::inst_fx65
 };
 
-Chip8::Chip8(const std::string &path_to_rom, const std::string &path_to_sound, const uint8_t scale_factor, const std::string &title) 
-    : font_sprites({
-            0xf0, 0x90, 0x90, 0x90, 0xf0, // 0
-            0x20, 0x60, 0x20, 0x20, 0x70, // 1
-            0xf0, 0x10, 0xf0, 0x80, 0xf0, // 2
-            0xf0, 0x10, 0xf0, 0x10, 0xf0, // 3
-            0x90, 0x90, 0xf0, 0x10, 0x10, // 4
-            0xf0, 0x80, 0xf0, 0x10, 0xf0, // 5
-            0xf0, 0x80, 0xf0, 0x90, 0xf0, // 6
-            0xf0, 0x10, 0x20, 0x40, 0x40, // 7
-            0xf0, 0x90, 0xf0, 0x90, 0xf0, // 8
-            0xf0, 0x90, 0xf0, 0x10, 0xf0, // 9
-            0xf0, 0x90, 0xf0, 0x90, 0x90, // A
-            0xe0, 0x90, 0xe0, 0x90, 0xe0, // B
-            0xf0, 0x80, 0x80, 0x80, 0xf0, // C
-            0xe0, 0x90, 0x90, 0x90, 0xe0, // D
-            0xf0, 0x80, 0xf0, 0x80, 0xf0, // E
-            0xf0, 0x80, 0xf0, 0x80, 0x80  // F
-            }),
-      rand_byte_gen(), // RandomByteGenerator object construction
+const std::array<uint8_t, fontset_size> Chip8::font_sprites {
+    0xf0, 0x90, 0x90, 0x90, 0xf0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xf0, 0x10, 0xf0, 0x80, 0xf0, // 2
+    0xf0, 0x10, 0xf0, 0x10, 0xf0, // 3
+    0x90, 0x90, 0xf0, 0x10, 0x10, // 4
+    0xf0, 0x80, 0xf0, 0x10, 0xf0, // 5
+    0xf0, 0x80, 0xf0, 0x90, 0xf0, // 6
+    0xf0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xf0, 0x90, 0xf0, 0x90, 0xf0, // 8
+    0xf0, 0x90, 0xf0, 0x10, 0xf0, // 9
+    0xf0, 0x90, 0xf0, 0x90, 0x90, // A
+    0xe0, 0x90, 0xe0, 0x90, 0xe0, // B
+    0xf0, 0x80, 0x80, 0x80, 0xf0, // C
+    0xe0, 0x90, 0x90, 0x90, 0xe0, // D
+    0xf0, 0x80, 0xf0, 0x80, 0xf0, // E
+    0xf0, 0x80, 0xf0, 0x80, 0x80  // F
+};
+
+#ifdef CHIP8_HEADLESS
+Chip8::Chip8()
+    : rom_size(), // empty memory until load_image()
+      rom_load_addr(0x200), // ROMs always loaded at address 0x200
+      quirks(),
+      fault(),
+      dirty_pages(),
+      display_dirty(),
+      rand_byte_gen(),
+      shared_input_keys() {
+    initialize_vm();
+}
+#else
+Chip8::Chip8(const std::string &path_to_rom, const std::string &path_to_sound, const uint8_t scale_factor, const std::string &title, const ScaleFilter filter, const RomPack *rom_pack) 
+    : gfx_obj(display_width, display_height, scale_factor, title, filter), // Graphics object creation
+      overlay_visible(),
       rom_load_addr(0x200), // ROMs always loaded at address 0x200
-      gfx_obj(display_width, display_height, scale_factor, title) /* Graphics object creation */ {
+      quirks(), // no quirks unless the ROM pack says otherwise
+      fault(),
+      dirty_pages(),
+      display_dirty(),
+      rand_byte_gen(), // RandomByteGenerator object construction
+      shared_input_keys() {
     
-    load_rom(path_to_rom); 
+    if (rom_pack) {
+        load_rom(*rom_pack, path_to_rom);
+    } else {
+        load_rom(path_to_rom); 
+    }
     load_sound(path_to_sound);
     initialize_vm();
+#ifdef CHIP8_AOT
+    aot_init();
+#endif
+#ifdef CHIP8_PROFILER
+    // profiles of different ROMs don't overwrite each other, they are written to the working directory
+    profile_prefix = path_to_rom.substr(path_to_rom.find_last_of('/') + 1);
+#endif
 }
 
 void Chip8::load_sound(const std::string &path_to_sound) {
@@ -235,6 +275,7 @@ void Chip8::load_sound(const std::string &path_to_sound) {
     }
     beep.setBuffer(sound_buffer);
 }
+#endif
 
 void Chip8::load_rom(const std::string &path_to_rom) {
     std::ifstream rom_ifstream { path_to_rom, std::ios::binary };
@@ -255,6 +296,89 @@ void Chip8::load_rom(const std::string &path_to_rom) {
     rom_ifstream.close();
 }
 
+// the image is copied straight from the shared mapping of the pack
+void Chip8::load_rom(const RomPack &rom_pack, const std::string &rom_name) {
+    const RomPackEntry *entry { rom_pack.find(rom_name) };
+    if (!entry) {
+        fprintf(stderr, "ROM '%s' is not found in the ROM pack\n", rom_name.data());
+        exit(EXIT_FAILURE);
+    }
+    if (entry->size > (memory_size - rom_load_addr)) {
+        fprintf(stderr, "'%s' is too large (%u bytes)\nMaximum allowed ROM size is %d bytes\n", rom_name.data(), entry->size, memory_size - rom_load_addr);
+        exit(EXIT_FAILURE);
+    }
+    if (!rom_pack.intact(*entry)) {
+        fprintf(stderr, "'%s' is corrupted in the ROM pack (hash mismatch)\n", rom_name.data());
+        exit(EXIT_FAILURE);
+    }
+    rom_size = entry->size;
+    quirks = entry->quirks;
+    std::copy(rom_pack.image(*entry), rom_pack.image(*entry) + rom_size, memory.begin() + rom_load_addr);
+}
+
+bool Chip8::load_image(const uint8_t *image, const size_t size) noexcept {
+    if (size > static_cast<size_t>(memory_size - rom_load_addr)) {
+        return false;
+    }
+    rom_size = size;
+    std::copy(image, image + size, memory.begin() + rom_load_addr);
+    mark_dirty(rom_load_addr, size);
+#ifdef CHIP8_AOT
+    aot_init();
+#endif
+    return true;
+}
+
+bool Chip8::load_image(const RomPack &rom_pack, const std::string &rom_name) noexcept {
+    const RomPackEntry *entry { rom_pack.find(rom_name) };
+    if (!entry || !rom_pack.intact(*entry) || !load_image(rom_pack.image(*entry), entry->size)) {
+        return false;
+    }
+    quirks = entry->quirks;
+    return true;
+}
+
+void Chip8::save_cpu_state(CpuState &cpu) const noexcept {
+    std::memcpy(&cpu.reg, &reg, sizeof(reg));
+    std::memcpy(cpu.stack.data(), stack.data(), sizeof(stack));
+    std::memcpy(cpu.keypad.data(), keypad.data(), sizeof(keypad));
+    std::memcpy(&cpu.timer, &timer, sizeof(timer));
+    std::memcpy(&cpu.key_wait, &key_wait, sizeof(key_wait));
+    cpu.rand_byte_gen = rand_byte_gen;
+    cpu.timers_phase = timers_phase;
+    cpu.rom_size = rom_size;
+    cpu.quirks = quirks;
+    cpu.fault = fault;
+}
+
+void Chip8::restore_cpu_state(const CpuState &cpu) noexcept {
+    std::memcpy(&reg, &cpu.reg, sizeof(reg));
+    std::memcpy(stack.data(), cpu.stack.data(), sizeof(stack));
+    std::memcpy(keypad.data(), cpu.keypad.data(), sizeof(keypad));
+    std::memcpy(&timer, &cpu.timer, sizeof(timer));
+    std::memcpy(&key_wait, &cpu.key_wait, sizeof(key_wait));
+    rand_byte_gen = cpu.rand_byte_gen;
+    timers_phase = cpu.timers_phase;
+    rom_size = cpu.rom_size;
+    quirks = cpu.quirks;
+    fault = cpu.fault;
+}
+
+void Chip8::save_snapshot(Snapshot &snapshot) const noexcept {
+    std::memcpy(snapshot.memory.data(), memory.data(), sizeof(memory));
+    std::memcpy(snapshot.display.data(), display.data(), sizeof(display));
+    save_cpu_state(snapshot.cpu);
+}
+
+void Chip8::restore_snapshot(const Snapshot &snapshot) noexcept {
+    std::memcpy(memory.data(), snapshot.memory.data(), sizeof(memory));
+    std::memcpy(display.data(), snapshot.display.data(), sizeof(display));
+    restore_cpu_state(snapshot.cpu);
+#ifdef CHIP8_AOT
+    aot_init(); // the restored memory may hold code the blocks have been invalidated for
+#endif
+}
+
 // Turn off all the pixels on the display
 inline void Chip8::clear_display() noexcept {
     std::for_each(display.begin(), 
@@ -264,9 +388,21 @@ inline void Chip8::clear_display() noexcept {
                   });
 }
 
+// pages overlapping [addr, addr + len) have been written
+inline void Chip8::mark_dirty(const uint16_t addr, const uint16_t len) noexcept {
+    if (!len) {
+        return;
+    }
+    for (unsigned page = addr / memory_page_size; page <= (addr + len - 1u) / memory_page_size; page++) {
+        dirty_pages |= 1u << page;
+    }
+}
+
 void Chip8::initialize_vm() {
     std::memset(&reg, 0, sizeof(reg)); // reset all the registers
     std::memset(&timer, 0, sizeof(timer)); // reset all the timers
+    std::memset(&key_wait, 0, sizeof(key_wait)); // the CPU is not waiting for a key
+    timers_phase = 0;
     reg.pc = rom_load_addr; // set the program counter to the beginning of the ROM code
     std::fill(memory.begin(), memory.begin() + rom_load_addr, 0); // pad the memory with zeroes up to the ROM start address
     std::fill(memory.begin() + rom_load_addr + rom_size, memory.end(), 0); // pad the memory after the ROM mapping with zeroes
@@ -282,17 +418,81 @@ inline void Chip8::update_timers() noexcept {
         timer.delay--;
     }
     if (timer.sound > 0) {
+#ifndef CHIP8_HEADLESS
         if (timer.sound == 1) {
+            // the previous beep is cut short, the closest thing to an underrun SFML lets us observe
+            if (beep.getStatus() == sf::Sound::Playing) {
+                metrics.on_audio_restart();
+            }
             beep.play();
         }
+#endif
         timer.sound--;
     }
 }
 
+#ifndef CHIP8_HEADLESS
+void Chip8::export_metrics(const std::string &path) {
+    metrics.start_export(path);
+}
+#endif
+
+void Chip8::export_shared_frame(const std::string &shm_name) {
+    shared_frame = std::make_unique<SharedFrame>(shm_name);
+    sync_shared_frame();
+}
+
+// called at the timers rate, so consumers get a consistent snapshot per frame and the emulator never blocks on them
+void Chip8::sync_shared_frame() noexcept {
+    SharedFrameLayout &frame { shared_frame->begin_update() };
+    for (uint8_t row {}; row < display_height; row++) {
+        std::copy(display[row].begin(), display[row].end(), frame.display[row]);
+    }
+    std::copy(reg.V.begin(), reg.V.end(), frame.V);
+    frame.I = reg.I;
+    frame.pc = reg.pc;
+    frame.sp = reg.sp;
+    frame.delay_timer = timer.delay;
+    frame.sound_timer = timer.sound;
+    std::copy(keypad.begin(), keypad.end(), frame.keypad);
+    shared_frame->end_update();
+    // only the keys changed by the consumers are applied, so they don't override the keyboard state
+    const uint16_t input_keys { shared_frame->input_keys() },
+                   changed { static_cast<uint16_t>(input_keys ^ shared_input_keys) };
+    shared_input_keys = input_keys;
+    for (uint8_t key {}; key < keypad_size; key++) {
+        if (changed & (1u << key)) {
+            keypad[key] = (input_keys >> key) & 0x1u;
+        }
+    }
+    if (changed && key_wait.active) {
+        resume_key_wait();
+    }
+}
+
+#ifdef CHIP8_DEBUGGER
+void Chip8::attach_debugger(const uint16_t port) {
+    debugger = std::make_unique<Debugger>(*this, port);
+}
+#endif
+
+// idle loop fast-forwarding and recompiled blocks retire several instructions at once, which would step over breakpoints
+inline bool Chip8::fast_paths_enabled() const noexcept {
+#ifdef CHIP8_DEBUGGER
+    return !debugger || !debugger->attached();
+#else
+    return true;
+#endif
+}
+
 // this method fetches the current instruction and decodes it 
-inline void Chip8::emulate_cpu_cycle() noexcept {
+inline void Chip8::fetch_instruction() noexcept {
     // fetch the current instruction to be emulated
     instruction = (memory[reg.pc] << 8) | memory[reg.pc + 1];
+    decode_instruction();
+}
+
+inline void Chip8::decode_instruction() noexcept {
     // filter all relevant bytes and nibbles
     opcode = (instruction & 0xf000) >> 12;
     nnn = instruction & 0x0fff;
@@ -300,11 +500,201 @@ inline void Chip8::emulate_cpu_cycle() noexcept {
     y = (instruction & 0x00f0) >> 4;
     n = instruction & 0x000f;
     kk = instruction & 0x00ff;
+}
+
+inline void Chip8::emulate_cpu_cycle() noexcept {
+#ifdef CHIP8_DEBUGGER
+    if (debugger && debugger->should_stop(reg.pc)) {
+        debugger->stop(); // the VM stays here while the GDB client inspects it
+        if (!gfx_obj.window.isOpen()) {
+            return;
+        }
+    }
+#endif
+    if (reg.pc > memory_size - 2) {
+        fault = Fault::memory_out_of_bounds;
+        return;
+    }
+#ifdef CHIP8_SPECIALIZED_DISPATCH
+    // the specialized handlers know their operands, only the instruction itself is fetched
+    instruction = (memory[reg.pc] << 8) | memory[reg.pc + 1];
+#else
+    fetch_instruction();
+#endif
+#ifdef CHIP8_PROFILER
+    profiler.on_instruction(reg.pc, instruction);
+#endif
+#ifdef CHIP8_TRACE
     printf("Emulated instruction : 0x%.4x at address 0x%.4x\n", instruction, reg.pc);
+#endif
+#ifdef CHIP8_SPECIALIZED_DISPATCH
+    // a single indirect call indexed by the instruction
+    Chip8::specialized_jt[instruction](*this);
+#else
     // jump to the master jump table, the appropriate instruction decoding function will be called
     (this->*Chip8::global_jt[opcode])();
+#endif
+}
+
+#ifdef CHIP8_AOT
+// the recompiled blocks are used only if the loaded ROM is exactly the image they have been translated from
+void Chip8::aot_init() noexcept {
+    aot_lookup.fill(nullptr);
+    aot_code_map.reset();
+    if (rom_size != aot_rom_size || !std::equal(aot_rom_image, aot_rom_image + aot_rom_size, memory.begin() + rom_load_addr)) {
+        fprintf(stderr, "The loaded ROM differs from the statically recompiled one, falling back to the interpreter\n");
+        return;
+    }
+    for (uint16_t idx {}; idx < aot_block_count; idx++) {
+        const AotBlock &block { aot_blocks[idx] };
+        for (uint16_t addr { block.addr }; addr < block.addr + block.length * 2 && addr < memory_size; addr++) {
+            aot_code_map.set(addr);
+            // the middle of a block is an entry too, e.g. for the rest of a block cut short at a timers update
+            if (!((addr - block.addr) % 2) && (!aot_lookup[addr] || addr == block.addr)) {
+                aot_lookup[addr] = &block;
+            }
+        }
+    }
+}
+
+// runs the recompiled block covering pc (if any) from pc on, at most max_cycles instructions of it
+// returns the amount of retired CPU cycles, 0 if pc is interpreted
+unsigned Chip8::aot_run_block(const unsigned max_cycles) noexcept {
+    const AotBlock *block { reg.pc < memory_size ? aot_lookup[reg.pc] : nullptr };
+    if (!block) {
+        return 0;
+    }
+    const unsigned first { (reg.pc - block->addr) / 2u },
+                   last { std::min<unsigned>(block->length, first + max_cycles) };
+#ifdef CHIP8_PROFILER
+    for (unsigned addr { block->addr + first * 2 }; addr < block->addr + last * 2u; addr += 2) {
+        profiler.on_instruction(addr, (memory[addr] << 8) | memory[addr + 1]);
+    }
+#endif
+    block->fn(*this, first, last);
+    return last - first;
+}
+
+// recompiled blocks call back into the interpreter for instructions with side effects (drawing, sound, memory writes, etc.)
+void Chip8::aot_step() noexcept {
+    fetch_instruction();
+    (this->*Chip8::global_jt[opcode])();
 }
 
+// self-modifying code - drop every block overlapping [addr, addr + len), these addresses are interpreted from now on
+void Chip8::aot_invalidate(const uint16_t addr, const uint16_t len) noexcept {
+    bool hit {};
+    for (uint16_t idx {}; idx < len && addr + idx < memory_size; idx++) {
+        hit |= aot_code_map.test(addr + idx);
+    }
+    if (!hit) {
+        return;
+    }
+    for (uint16_t idx {}; idx < aot_block_count; idx++) {
+        const AotBlock &block { aot_blocks[idx] };
+        if (addr < block.addr + block.length * 2 && block.addr < addr + len) {
+            for (uint16_t entry { block.addr }; entry < block.addr + block.length * 2 && entry < memory_size; entry += 2) {
+                if (aot_lookup[entry] == &block) {
+                    aot_lookup[entry] = nullptr;
+                }
+            }
+        }
+    }
+}
+#endif
+
+// Detects the idle loop "LD Vx, DT; SE Vx, 0x00; JP <LD Vx, DT>" at pc while the delay timer is running.
+// Every iteration that starts before the next timers update reads the same non-zero delay value and jumps back,
+// so all of them are retired at once with the exact amount of CPU cycles they would have taken.
+// Only whole iterations that fit into budget are retired, the loop is left at its start as after interpreting them.
+// Returns the amount of retired CPU cycles, 0 if there is no busy wait at pc (or not a single iteration fits).
+inline unsigned Chip8::skip_delay_wait(const unsigned cycle_cnt, const unsigned budget) noexcept {
+    constexpr unsigned loop_length { 3 };
+    if (!timer.delay || reg.pc + loop_length * 2 > memory_size) {
+        return 0;
+    }
+    const uint8_t vx { static_cast<uint8_t>(memory[reg.pc] & 0x0f) };
+    if ((memory[reg.pc] & 0xf0) != 0xf0 || memory[reg.pc + 1] != 0x07 || // LD Vx, DT
+        memory[reg.pc + 2] != (0x30 | vx) || memory[reg.pc + 3] != 0x00 || // SE Vx, 0x00
+        memory[reg.pc + 4] != (0x10 | (reg.pc >> 8)) || memory[reg.pc + 5] != (reg.pc & 0xff)) { // JP pc
+        return 0;
+    }
+    // iterations whose LD Vx, DT is executed before the timers get updated
+    const unsigned iterations { std::min((timers_clock_cycles - cycle_cnt + loop_length - 1) / loop_length, budget / loop_length) };
+    if (!iterations) {
+        return 0;
+    }
+    reg.V[vx] = timer.delay;
+#ifdef CHIP8_PROFILER
+    for (unsigned idx {}; idx < loop_length; idx++) {
+        profiler.on_instruction(reg.pc + idx * 2, (memory[reg.pc + idx * 2] << 8) | memory[reg.pc + idx * 2 + 1], iterations);
+    }
+#endif
+    return iterations * loop_length;
+}
+
+// amount of CPU cycles at full speed, the timers are updated every timers_clock_cycles cycles as in run()
+Fault Chip8::run_cycles(unsigned cycles) noexcept {
+    unsigned cycle_cnt { timers_phase }; // continues where the previous call left off
+    while (cycles && fault == Fault::none) {
+        unsigned retired {};
+        if (key_wait.active) {
+            // keys held in the keypad (set between the calls, e.g. by VmPool) complete LD Vx, K
+            resume_key_wait();
+        }
+        if (key_wait.active) {
+            // nothing else can press a key, the CPU stays suspended for good once the timers have run out
+            if (!timer.delay && !timer.sound) {
+                break;
+            }
+            retired = std::min(cycles, timers_clock_cycles - cycle_cnt);
+        } else {
+            retired = skip_delay_wait(cycle_cnt, cycles);
+        }
+#ifdef CHIP8_AOT
+        if (!retired) {
+            retired = aot_run_block(std::min(cycles, timers_clock_cycles - cycle_cnt));
+        }
+#endif
+        if (!retired) {
+            emulate_cpu_cycle();
+            retired = 1;
+        }
+        cycles -= retired;
+        cycle_cnt += retired;
+        if (cycle_cnt >= timers_clock_cycles) {
+            update_timers();
+            cycle_cnt -= timers_clock_cycles;
+            // the frame is published at the emulated timers rate, as in run()
+            if (shared_frame) {
+                sync_shared_frame();
+            }
+        }
+    }
+    timers_phase = cycle_cnt;
+    return fault;
+}
+
+void Chip8::report_fault() const noexcept {
+    switch (fault) {
+        case Fault::stack_overflow:
+            std::cerr << "Stack overflow!" << std::endl;
+            break;
+        case Fault::stack_underflow:
+            std::cerr << "Stack underflow!" << std::endl;
+            break;
+        case Fault::illegal_instruction:
+            fprintf(stderr, "Illegal instruction : 0x%.4x at address 0x%x\n", instruction, reg.pc);
+            break;
+        case Fault::memory_out_of_bounds:
+            fprintf(stderr, "Memory access out of bounds at address 0x%x (I = 0x%x)\n", reg.pc, reg.I);
+            break;
+        default:
+            break;
+    }
+}
+
+#ifndef CHIP8_HEADLESS
 inline void Chip8::handle_key_down(sf::Event &e) noexcept {
     switch (e.key.code) {
         case sf::Keyboard::Num1:   keypad[0x1] = 1; break;
@@ -324,8 +714,15 @@ inline void Chip8::handle_key_down(sf::Event &e) noexcept {
         case sf::Keyboard::C:      keypad[0xb] = 1; break;
         case sf::Keyboard::V:      keypad[0xf] = 1; break;
         case sf::Keyboard::Escape: gfx_obj.window.close(); break;
+        case sf::Keyboard::Tab:
+            overlay_visible = !overlay_visible;
+            refresh_overlay();
+            break;
         default: break;
     }
+    if (key_wait.active) {
+        resume_key_wait();
+    }
 }
 
 inline void Chip8::handle_key_up(sf::Event &e) noexcept {
@@ -351,44 +748,125 @@ inline void Chip8::handle_key_up(sf::Event &e) noexcept {
     }
 }
 
-void Chip8::run() noexcept {
+inline void Chip8::handle_event(sf::Event &e) noexcept {
+    // handle the pressed key
+    switch (e.type) {
+        case sf::Event::Closed:
+            gfx_obj.window.close();
+            break;
+        case sf::Event::EventType::KeyPressed:
+            handle_key_down(e);
+            break;
+        case sf::Event::EventType::KeyReleased:
+            handle_key_up(e);
+            break;
+        default:
+            break;
+    }
+}
+
+// redraws the frame with the current metrics on top of it (or without them once the overlay is hidden)
+void Chip8::refresh_overlay() noexcept {
+    gfx_obj.set_overlay(overlay_visible ? metrics.overlay_lines() : std::vector<std::string> {}, font_sprites.data());
+    gfx_obj.redraw_screen<display_width, display_height>(display);
+}
+
+Fault Chip8::run() noexcept {
     sf::Event e;
-    unsigned cycle_cnt {};
-    while (gfx_obj.window.isOpen()) {
-        while (gfx_obj.window.pollEvent(e)) {
-            // handle the pressed key
-            switch (e.type) {
-                case sf::Event::Closed:
-                    gfx_obj.window.close();
-                    break;
-                case sf::Event::EventType::KeyPressed:
-                    handle_key_down(e);
-                    break;
-                case sf::Event::EventType::KeyReleased:
-                    handle_key_up(e);
-                    break;
-                default:
-                    break;
+    unsigned cycle_cnt {}, overlay_ticks {};
+    auto last_tick { timestamp::now() }; // time of the last timers update
+    while (gfx_obj.window.isOpen() && fault == Fault::none) {
+        bool idle { key_wait.active && !timer.delay && !timer.sound && !shared_frame };
+#ifdef CHIP8_DEBUGGER
+        if (debugger && debugger->attached()) {
+            // GDB's interrupt arrives while the VM runs, the VM stops before its next instruction
+            debugger->poll_interrupt();
+            // LD Vx, K doesn't complete while the CPU is suspended, a single step or an interrupt is reported at it right away
+            if (key_wait.active && debugger->stop_pending()) {
+                debugger->stop();
+                continue;
+            }
+            idle = false; // the socket is polled at the pace of the CPU instead of sleeping in waitEvent()
+        }
+#endif
+        // the CPU is suspended by LD Vx, K and nothing else is going on - sleep until the next window event
+        // (external keypad input through the shared frame can't wake the window, so it is polled at the timers rate instead)
+        if (idle) {
+            if (gfx_obj.window.waitEvent(e)) {
+                handle_event(e);
             }
+            // the idle time isn't a late timers update
+            last_tick = timestamp::now();
+            continue;
+        }
+        while (gfx_obj.window.pollEvent(e)) {
+            handle_event(e);
         } 
         // measure the CPU cycle time
         auto start { timestamp::now() };
-        emulate_cpu_cycle();
+        unsigned retired {};
+        if (key_wait.active) {
+            // the CPU is suspended by LD Vx, K, only the timers are running - idle until their next update
+            retired = timers_clock_cycles - cycle_cnt;
+        } else {
+            // amount of CPU cycles retired by this iteration, a delay timer busy wait is fast-forwarded up to the next timers update
+            // (run() isn't bounded by a cycle budget, the last iteration may end past the timers update)
+            retired = fast_paths_enabled() ? skip_delay_wait(cycle_cnt, std::numeric_limits<unsigned>::max()) : 0;
+        }
+        // cycles the CPU has been suspended for or that have been fast-forwarded, nothing is emulated for them
+        const bool skipped { retired != 0 };
+        if (!retired) {
+#ifdef CHIP8_AOT
+            // the part of the block past the next timers update is left to the next iteration
+            retired = fast_paths_enabled() ? aot_run_block(timers_clock_cycles - cycle_cnt) : 0;
+            if (!retired) {
+                emulate_cpu_cycle();
+                retired = 1;
+            }
+#else
+            emulate_cpu_cycle();
+            retired = 1;
+#endif
+        }
         auto end { timestamp::now() };
-        cycle_cnt++;
+        cycle_cnt += retired;
+        if (skipped) {
+            metrics.on_cycles_skipped(retired);
+        } else {
+            metrics.on_instructions(retired);
+        }
         // timers updates happen every (CPU frequency / 60) CPU cycles, the update frequency is bounded to 60 Hz
-        if (cycle_cnt == timers_clock_cycles) {
+        if (cycle_cnt >= timers_clock_cycles) {
             update_timers();
-            cycle_cnt = 0;
+            cycle_cnt -= timers_clock_cycles;
+            if (shared_frame) {
+                sync_shared_frame();
+            }
+            metrics.on_timers_tick(float_duration_us(end - last_tick).count(), timers_clock_cycles * instruction_time * 1000.f);
+            last_tick = end;
+            // the overlay is refreshed once per second
+            if (overlay_visible && ++overlay_ticks >= timers_frequency) {
+                overlay_ticks = 0;
+                refresh_overlay();
+            }
         }
         float_duration_ms inst_time_elapsed { end - start };
-        // if the instruction execution time is less than 2 ms (for 500 Hz CPU frequency), sleep the (desired exec time - actual exec time)
+        // if the instructions execution time is less than 2 ms per instruction (for 500 Hz CPU frequency), sleep the (desired exec time - actual exec time)
         // It emulates the original Chip-8 frequency - 500 Hz
-        if (inst_time_elapsed.count() < instruction_time) {
-            std::this_thread::sleep_for(float_duration_ms(instruction_time - inst_time_elapsed.count()));
+        if (inst_time_elapsed.count() < instruction_time * retired) {
+            const float_duration_ms requested { instruction_time * retired - inst_time_elapsed.count() };
+            auto sleep_start { timestamp::now() };
+            std::this_thread::sleep_for(requested);
+            metrics.on_sleep(float_duration_us(timestamp::now() - sleep_start - requested).count());
         }
     }
+#ifdef CHIP8_PROFILER
+    profiler.dump(profile_prefix, memory.data());
+#endif
+    report_fault();
+    return fault;
 }
+#endif
 
 // =============================== SUBTABLE DISPATCH ROUTINES =========================================== 
 inline void Chip8::dispatch_0() noexcept {
@@ -428,6 +906,7 @@ inline void Chip8::dispatch_f() noexcept {
 // instruction : CLS
 inline void Chip8::inst_00e0() noexcept {
     clear_display();
+    display_dirty = true;
     reg.pc += 2;
 }
 
@@ -436,9 +915,11 @@ inline void Chip8::inst_00ee() noexcept {
     if (reg.sp > 0) {
         reg.pc = stack[--reg.sp];
         reg.pc += 2; 
+#ifdef CHIP8_PROFILER
+        profiler.on_return(reg.sp);
+#endif
     } else {
-        std::cerr << "Stack underflow!" << std::endl;
-        exit(EXIT_FAILURE);
+        fault = Fault::stack_underflow;
     }
 }
 
@@ -452,9 +933,11 @@ inline void Chip8::inst_2nnn() noexcept {
     if (reg.sp < (stack_size - 1)) {
         stack[reg.sp++] = reg.pc;
         reg.pc = nnn;
+#ifdef CHIP8_PROFILER
+        profiler.on_call(nnn, reg.sp);
+#endif
     } else {
-        std::cerr << "Stack overflow!" << std::endl;
-        exit(EXIT_FAILURE);
+        fault = Fault::stack_overflow;
     }
 }
 
@@ -580,15 +1063,20 @@ inline void Chip8::inst_cxkk() noexcept {
 
 // instruction : DRW Vx, Vy, nibble 
 inline void Chip8::inst_dxyn() noexcept {
-    // in case of display overflow, the sprite wraps around the screen
+    if (reg.I + n > memory_size) {
+        fault = Fault::memory_out_of_bounds;
+        return;
+    }
+    // the sprite origin wraps around the screen, the part of the sprite past the right or bottom edge is clipped
     uint8_t coord_x = reg.V[x] % 64,
             coord_y = reg.V[y] % 32,
-            sprite_height = n;
+            sprite_height = std::min<uint8_t>(n, display_height - coord_y),
+            sprite_width = std::min<uint8_t>(8, display_width - coord_x);
     // default state - no collision
     reg.V[0xf] = 0;
     for (uint8_t row {}; row < sprite_height; row++) {
         uint8_t px_to_draw { memory[reg.I + row] }; // pixel to draw on the screen
-        for (uint8_t bit_pos {}; bit_pos < 8; bit_pos++) {
+        for (uint8_t bit_pos {}; bit_pos < sprite_width; bit_pos++) {
             uint8_t &curr_px { display[coord_y + row][coord_x + bit_pos] }; // current pixel on the screen (can be on or off)
             uint8_t sprite_px = (px_to_draw >> (7 - bit_pos)) & 0x1u;
             // if both pixels are on -> collision has been occured
@@ -599,13 +1087,18 @@ inline void Chip8::inst_dxyn() noexcept {
             curr_px ^= sprite_px;
         }
     }
+    display_dirty = true;
+#ifndef CHIP8_HEADLESS
+    auto present_start { timestamp::now() };
     gfx_obj.redraw_screen<display_width, display_height>(display);
+    metrics.on_frame_presented(float_duration_us(timestamp::now() - present_start).count());
+#endif
     reg.pc += 2;
 }
 
 // instruction : SKP Vx
 inline void Chip8::inst_ex9e() noexcept {
-    if (keypad[reg.V[x]]) {
+    if (keypad[reg.V[x] & 0xf]) { // only the lowest nibble selects a key
         reg.pc += 2;
     } 
     reg.pc += 2;
@@ -613,7 +1106,7 @@ inline void Chip8::inst_ex9e() noexcept {
 
 // instruction : SKNP Vx
 inline void Chip8::inst_exa1() noexcept {
-    if (!keypad[reg.V[x]]) {
+    if (!keypad[reg.V[x] & 0xf]) {
         reg.pc += 2;
     } 
     reg.pc += 2;
@@ -627,10 +1120,19 @@ inline void Chip8::inst_fx07() noexcept {
 
 // instruction : LD Vx, K 
 inline void Chip8::inst_fx0a() noexcept {
+    // the CPU is suspended until a key is pressed, a key that is already held completes the instruction immediately
+    key_wait.active = true;
+    key_wait.reg = x;
+    resume_key_wait();
+}
+
+// completes the pending LD Vx, K if any key is held, the lowest held key is stored in Vx
+inline void Chip8::resume_key_wait() noexcept {
     for (uint8_t key {}; key < keypad_size; key++) {
         if (keypad[key]) {
-            reg.V[x] = key;
+            reg.V[key_wait.reg] = key;
             reg.pc += 2;
+            key_wait.active = false;
             return;
         }
     }
@@ -663,6 +1165,19 @@ inline void Chip8::inst_fx29() noexcept {
 
 // instruction : LD B, Vx
 inline void Chip8::inst_fx33() noexcept {
+    if (reg.I + 3 > memory_size) {
+        fault = Fault::memory_out_of_bounds;
+        return;
+    }
+#ifdef CHIP8_DEBUGGER
+    if (debugger) {
+        debugger->on_memory_write(reg.I, 3);
+    }
+#endif
+#ifdef CHIP8_AOT
+    aot_invalidate(reg.I, 3);
+#endif
+    mark_dirty(reg.I, 3);
     memory[reg.I] = reg.V[x] / 100;
     memory[reg.I + 1] = (reg.V[x] / 10) % 10;
     memory[reg.I + 2] = reg.V[x] % 10;
@@ -671,23 +1186,215 @@ inline void Chip8::inst_fx33() noexcept {
 
 // instruction : LD [I], Vx 
 inline void Chip8::inst_fx55() noexcept {
+    if (reg.I + x + 1 > memory_size) {
+        fault = Fault::memory_out_of_bounds;
+        return;
+    }
+#ifdef CHIP8_DEBUGGER
+    if (debugger) {
+        debugger->on_memory_write(reg.I, x + 1);
+    }
+#endif
+#ifdef CHIP8_AOT
+    aot_invalidate(reg.I, x + 1);
+#endif
+    mark_dirty(reg.I, x + 1);
     for (uint8_t idx {}; idx <= x; idx++) {
         memory[reg.I + idx] = reg.V[idx];
     }
-    //reg.I += x + 1; // may be required by some ROMs
+    if (quirks & quirk_load_store_increments_i) {
+        reg.I += x + 1;
+    }
     reg.pc += 2;
 }
 
 // instruction : LD Vx, [I] 
 inline void Chip8::inst_fx65() noexcept {
+    if (reg.I + x + 1 > memory_size) {
+        fault = Fault::memory_out_of_bounds;
+        return;
+    }
     for (uint8_t idx {}; idx <= x; idx++) {
         reg.V[idx] = memory[reg.I + idx];
     }
-    //reg.I += x + 1; // may be required by some ROMs
+    if (quirks & quirk_load_store_increments_i) {
+        reg.I += x + 1;
+    }
     reg.pc += 2;
 }
 
 void Chip8::invalid_instruction_handler() noexcept {
-    fprintf(stderr, "Illegal instruction : 0x%.4x at address 0x%x\n", instruction, reg.pc);
-    exit(EXIT_FAILURE);
+    fault = Fault::illegal_instruction;
+}
+
+#ifdef CHIP8_SPECIALIZED_DISPATCH
+// ============================= SPECIALIZED HANDLER TABLE (CHIP8_SPECIALIZED_DISPATCH) =============================
+// Register file instructions get their own instantiation per instruction value with x, y and kk folded into constants.
+// 1nnn, Annn and Bnnn share one instantiation per opcode and mask nnn out of the fetched instruction, a constant address
+// saves a single AND but 12288 instantiations. Instructions with side effects beyond the register file (drawing, stack,
+// memory, RNG, key wait) decode the operands at runtime and call the regular routine above. Encodings the jump tables
+// treat alike share one instantiation.
+
+template <uint16_t ins>
+inline void Chip8::specialized_inst(Chip8 &vm) noexcept {
+    constexpr uint8_t opcode = (ins & 0xf000) >> 12,
+                      x = (ins & 0x0f00) >> 8,
+                      y = (ins & 0x00f0) >> 4,
+                      n = ins & 0x000f,
+                      kk = ins & 0x00ff;
+    const uint16_t nnn = vm.instruction & 0x0fff;
+    auto &reg { vm.reg };
+    if constexpr (opcode == 0x1) { // JP nnn
+        reg.pc = nnn;
+    } else if constexpr (opcode == 0x3) { // SE Vx, kk
+        reg.pc += reg.V[x] == kk ? 4 : 2;
+    } else if constexpr (opcode == 0x4) { // SNE Vx, kk
+        reg.pc += reg.V[x] != kk ? 4 : 2;
+    } else if constexpr (opcode == 0x5) { // SE Vx, Vy
+        reg.pc += reg.V[x] == reg.V[y] ? 4 : 2;
+    } else if constexpr (opcode == 0x6) { // LD Vx, kk
+        reg.V[x] = kk;
+        reg.pc += 2;
+    } else if constexpr (opcode == 0x7) { // ADD Vx, kk
+        reg.V[x] += kk;
+        reg.pc += 2;
+    } else if constexpr (opcode == 0x8) {
+        if constexpr (n == 0x0) { // LD Vx, Vy
+            reg.V[x] = reg.V[y];
+        } else if constexpr (n == 0x1) { // OR Vx, Vy
+            reg.V[x] |= reg.V[y];
+        } else if constexpr (n == 0x2) { // AND Vx, Vy
+            reg.V[x] &= reg.V[y];
+        } else if constexpr (n == 0x3) { // XOR Vx, Vy
+            reg.V[x] ^= reg.V[y];
+        } else if constexpr (n == 0x4) { // ADD Vx, Vy
+            reg.V[0xf] = (reg.V[x] + reg.V[y]) > 255 ? 1 : 0;
+            reg.V[x] = (reg.V[x] + reg.V[y]) & 0x00ff;
+        } else if constexpr (n == 0x5) { // SUB Vx, Vy
+            reg.V[0xf] = reg.V[x] < reg.V[y] ? 0 : 1;
+            reg.V[x] -= reg.V[y];
+        } else if constexpr (n == 0x6) { // SHR Vx {, Vy}
+            reg.V[0xf] = reg.V[x] & 0x1u;
+            reg.V[x] >>= 1;
+        } else if constexpr (n == 0x7) { // SUBN Vx, Vy
+            reg.V[0xf] = reg.V[x] > reg.V[y] ? 0 : 1;
+            reg.V[x] = reg.V[y] - reg.V[x];
+        } else { // SHL Vx {, Vy}
+            reg.V[0xf] = reg.V[x] >> 7;
+            reg.V[x] <<= 1;
+        }
+        reg.pc += 2;
+    } else if constexpr (opcode == 0x9) { // SNE Vx, Vy
+        reg.pc += reg.V[x] != reg.V[y] ? 4 : 2;
+    } else if constexpr (opcode == 0xa) { // LD I, nnn
+        reg.I = nnn;
+        reg.pc += 2;
+    } else if constexpr (opcode == 0xb) { // JP V0, nnn
+        reg.pc = nnn + reg.V[0];
+    } else if constexpr (opcode == 0xe) {
+        if constexpr (kk == 0x9e) { // SKP Vx
+            reg.pc += vm.keypad[reg.V[x] & 0xf] ? 4 : 2;
+        } else { // SKNP Vx
+            reg.pc += !vm.keypad[reg.V[x] & 0xf] ? 4 : 2;
+        }
+    } else if constexpr (opcode == 0xf) {
+        if constexpr (kk == 0x07) { // LD Vx, DT
+            reg.V[x] = vm.timer.delay;
+        } else if constexpr (kk == 0x15) { // LD DT, Vx
+            vm.timer.delay = reg.V[x];
+        } else if constexpr (kk == 0x18) { // LD ST, Vx
+            vm.timer.sound = reg.V[x];
+        } else if constexpr (kk == 0x1e) { // ADD I, Vx
+            reg.V[0xf] = (reg.I + reg.V[x]) > 0xfff ? 1 : 0;
+            reg.I += reg.V[x];
+        } else { // LD F, Vx
+            reg.I = reg.V[x] * 5;
+        }
+        reg.pc += 2;
+    }
+}
+
+template <void (Chip8::*handler)() noexcept>
+inline void Chip8::decoded_inst(Chip8 &vm) noexcept {
+    vm.decode_instruction();
+    (vm.*handler)();
+}
+
+// mirrors the decoding of the jump tables, so both backends execute every encoding identically
+template <uint16_t ins>
+constexpr Chip8::specialized_handler_t Chip8::select_specialized_handler() noexcept {
+    constexpr uint8_t opcode = (ins & 0xf000) >> 12,
+                      n = ins & 0x000f,
+                      kk = ins & 0x00ff;
+    constexpr uint16_t x_bits { ins & 0x0f00 };
+    if constexpr (opcode == 0x0) {
+        if constexpr (n == 0x0) {
+            return &decoded_inst<&Chip8::inst_00e0>;
+        } else if constexpr (n == 0xe) {
+            return &decoded_inst<&Chip8::inst_00ee>;
+        } else {
+            return &decoded_inst<&Chip8::invalid_instruction_handler>;
+        }
+    } else if constexpr (opcode == 0x2) {
+        return &decoded_inst<&Chip8::inst_2nnn>;
+    } else if constexpr (opcode == 0x1 || opcode == 0xa || opcode == 0xb) {
+        return &specialized_inst<ins & 0xf000>; // nnn is read at runtime
+    } else if constexpr (opcode == 0x5 || opcode == 0x9) {
+        return &specialized_inst<ins & 0xfff0>; // the lowest nibble is ignored
+    } else if constexpr (opcode == 0x8) {
+        if constexpr (n <= 0x7 || n == 0xe) {
+            return &specialized_inst<ins>;
+        } else {
+            return &decoded_inst<&Chip8::invalid_instruction_handler>;
+        }
+    } else if constexpr (opcode == 0xc) {
+        return &decoded_inst<&Chip8::inst_cxkk>;
+    } else if constexpr (opcode == 0xd) {
+        return &decoded_inst<&Chip8::inst_dxyn>;
+    } else if constexpr (opcode == 0xe) {
+        // the E subtable is indexed by the lowest nibble only
+        if constexpr (n == 0xe) {
+            return &specialized_inst<0xe09e | x_bits>;
+        } else if constexpr (n == 0x1) {
+            return &specialized_inst<0xe0a1 | x_bits>;
+        } else {
+            return &decoded_inst<&Chip8::invalid_instruction_handler>;
+        }
+    } else if constexpr (opcode == 0xf) {
+        if constexpr (kk == 0x07 || kk == 0x15 || kk == 0x18 || kk == 0x1e || kk == 0x29) {
+            return &specialized_inst<ins>;
+        } else if constexpr (kk == 0x0a) {
+            return &decoded_inst<&Chip8::inst_fx0a>;
+        } else if constexpr (kk == 0x33) {
+            return &decoded_inst<&Chip8::inst_fx33>;
+        } else if constexpr (kk == 0x55) {
+            return &decoded_inst<&Chip8::inst_fx55>;
+        } else if constexpr (kk == 0x65) {
+            return &decoded_inst<&Chip8::inst_fx65>;
+        } else {
+            return &decoded_inst<&Chip8::invalid_instruction_handler>;
+        }
+    } else {
+        return &specialized_inst<ins>;
+    }
+}
+
+// the rows are built with pack expansions in braced initializers, constant evaluation of a fold of 4096 assignments is quadratic
+template <uint8_t opcode, size_t... idx>
+constexpr std::array<Chip8::specialized_handler_t, 0x1000> Chip8::make_specialized_row(std::index_sequence<idx...>) noexcept {
+    return {{ select_specialized_handler<(opcode << 12) | idx>()... }};
 }
+
+template <size_t... opcodes>
+constexpr std::array<Chip8::specialized_handler_t, 0x10000> Chip8::make_specialized_jt(std::index_sequence<opcodes...>) noexcept {
+    const std::array<specialized_handler_t, 0x1000> rows[] { make_specialized_row<opcodes>(std::make_index_sequence<0x1000>())... };
+    std::array<specialized_handler_t, 0x10000> jt {};
+    for (size_t ins {}; ins < jt.size(); ins++) {
+        jt[ins] = rows[ins >> 12][ins & 0x0fff];
+    }
+    return jt;
+}
+
+// built entirely at compile time, it is placed in read-only data
+const std::array<Chip8::specialized_handler_t, 0x10000> Chip8::specialized_jt { Chip8::make_specialized_jt(std::make_index_sequence<0x10>()) };
+#endif
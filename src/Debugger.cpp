@@ -0,0 +1,269 @@
+#include "../include/Debugger.hpp"
+#include "../include/Chip8.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static std::string to_hex(const uint8_t *data, const size_t len) {
+    static const char digits[] { "0123456789abcdef" };
+    std::string out;
+    for (size_t idx {}; idx < len; idx++) {
+        out += digits[data[idx] >> 4];
+        out += digits[data[idx] & 0xf];
+    }
+    return out;
+}
+
+// [addr, addr + len) lies in the Chip-8 memory, written so that no sum of the client's values can wrap around
+static bool in_memory(const unsigned addr, const unsigned len) {
+    return len <= memory_size && addr <= memory_size - len;
+}
+
+// decodes len bytes of hex text, returns false on malformed input
+static bool from_hex(const char *text, uint8_t *data, const size_t len) {
+    for (size_t idx {}; idx < len; idx++) {
+        unsigned byte {};
+        if (sscanf(text + idx * 2, "%2x", &byte) != 1) {
+            return false;
+        }
+        data[idx] = byte;
+    }
+    return true;
+}
+
+Debugger::Debugger(Chip8 &vm, const uint16_t port)
+    : vm(vm),
+      stop_requested(true),
+      resumed(false),
+      interrupted(false),
+      watch_hit(-1),
+      client_fd(-1) {
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    const int reuse { 1 };
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // the stub is reachable only from the local host
+    if (listen_fd == -1 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || listen(listen_fd, 1) == -1) {
+        fprintf(stderr, "Cannot listen on 127.0.0.1:%u for the debugger\n", port);
+        exit(EXIT_FAILURE);
+    }
+    printf("Waiting for GDB on 127.0.0.1:%u ...\n", port);
+    client_fd = accept(listen_fd, nullptr, nullptr);
+    if (client_fd == -1) {
+        fprintf(stderr, "Debugger connection failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+Debugger::~Debugger() {
+    disconnect();
+    close(listen_fd);
+}
+
+void Debugger::disconnect() {
+    if (client_fd != -1) {
+        close(client_fd);
+        client_fd = -1;
+    }
+    // the VM runs freely from now on
+    breakpoints.reset();
+    watchpoints.reset();
+    stop_requested = false;
+}
+
+bool Debugger::read_packet(std::string &packet) {
+    char c {};
+    // skip acknowledgements and anything else until the start of a packet
+    do {
+        if (read(client_fd, &c, 1) != 1) {
+            return false;
+        }
+    } while (c != '$');
+    packet.clear();
+    uint8_t checksum {};
+    while (read(client_fd, &c, 1) == 1) {
+        if (c == '#') {
+            char sum_text[3] {};
+            unsigned expected {};
+            if (read(client_fd, sum_text, 2) != 2 || sscanf(sum_text, "%2x", &expected) != 1) {
+                return false;
+            }
+            const char ack { expected == checksum ? '+' : '-' };
+            if (write(client_fd, &ack, 1) != 1) {
+                return false;
+            }
+            return ack == '+' || read_packet(packet);
+        }
+        packet += c;
+        checksum += static_cast<uint8_t>(c);
+    }
+    return false;
+}
+
+void Debugger::send_packet(const std::string &payload) {
+    uint8_t checksum {};
+    for (const char c : payload) {
+        checksum += static_cast<uint8_t>(c);
+    }
+    char trailer[4] {};
+    snprintf(trailer, sizeof(trailer), "#%.2x", checksum);
+    const std::string packet { "$" + payload + trailer };
+    if (write(client_fd, packet.data(), packet.size()) != static_cast<ssize_t>(packet.size())) {
+        disconnect();
+    }
+}
+
+void Debugger::poll_interrupt() noexcept {
+    if (client_fd == -1 || !resumed) {
+        return;
+    }
+    char c {};
+    const ssize_t received { recv(client_fd, &c, 1, MSG_DONTWAIT) };
+    if (received == 0 || (received == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        disconnect();
+    } else if (received == 1 && c == '\x03') {
+        stop_requested = true;
+        interrupted = true;
+    }
+}
+
+void Debugger::stop() {
+    if (client_fd == -1) {
+        stop_requested = false;
+        return;
+    }
+    if (resumed) {
+        char reply[24] {};
+        if (watch_hit != -1) {
+            snprintf(reply, sizeof(reply), "T05watch:%x;", watch_hit);
+        } else if (interrupted) {
+            snprintf(reply, sizeof(reply), "S02"); // SIGINT
+        } else {
+            snprintf(reply, sizeof(reply), "S05");
+        }
+        send_packet(reply);
+        resumed = false;
+    }
+    watch_hit = -1;
+    interrupted = false;
+    std::string packet;
+    bool resume {};
+    while (client_fd != -1 && !resume) {
+        if (!read_packet(packet)) {
+            disconnect();
+            return;
+        }
+        const std::string reply { handle_packet(packet, resume) };
+        if (client_fd != -1 && !resume) {
+            send_packet(reply);
+        }
+    }
+}
+
+// returns the reply to the packet, resume is set if the VM has to continue running
+std::string Debugger::handle_packet(const std::string &packet, bool &resume) {
+    // register file as seen by the client
+    uint8_t regs[23] {};
+    std::copy(vm.reg.V.begin(), vm.reg.V.end(), regs);
+    regs[16] = vm.reg.I & 0xff;
+    regs[17] = vm.reg.I >> 8;
+    regs[18] = vm.reg.pc & 0xff;
+    regs[19] = vm.reg.pc >> 8;
+    regs[20] = vm.reg.sp;
+    regs[21] = vm.timer.delay;
+    regs[22] = vm.timer.sound;
+    // offset and size of every register inside of regs, indexed by the 'p' register number
+    static const uint8_t reg_offset[21] { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 18, 20, 21, 22 };
+    unsigned addr {}, len {}, type {};
+    switch (packet.empty() ? '\0' : packet[0]) {
+        case '?':
+            return "S05";
+        case 'g':
+            return to_hex(regs, sizeof(regs));
+        case 'G':
+            if (packet.size() != 1 + sizeof(regs) * 2 || !from_hex(packet.data() + 1, regs, sizeof(regs))) {
+                return "E01";
+            }
+            std::copy(regs, regs + 16, vm.reg.V.begin());
+            vm.reg.I = regs[16] | (regs[17] << 8);
+            vm.reg.pc = regs[18] | (regs[19] << 8);
+            vm.reg.sp = regs[20];
+            vm.timer.delay = regs[21];
+            vm.timer.sound = regs[22];
+            return "OK";
+        case 'p':
+            if (sscanf(packet.data() + 1, "%x", &addr) != 1 || addr >= sizeof(reg_offset)) {
+                return "E01";
+            }
+            return to_hex(regs + reg_offset[addr], addr == 16 || addr == 17 ? 2 : 1);
+        case 'm':
+            if (sscanf(packet.data() + 1, "%x,%x", &addr, &len) != 2 || !in_memory(addr, len)) {
+                return "E01";
+            }
+            return to_hex(vm.memory.data() + addr, len);
+        case 'M': {
+            const size_t colon { packet.find(':') };
+            if (sscanf(packet.data() + 1, "%x,%x", &addr, &len) != 2 || !in_memory(addr, len) ||
+                colon == std::string::npos || packet.size() - colon - 1 != len * 2 ||
+                !from_hex(packet.data() + colon + 1, vm.memory.data() + addr, len)) {
+                return "E01";
+            }
+#ifdef CHIP8_AOT
+            vm.aot_invalidate(addr, len);
+#endif
+            return "OK";
+        }
+        case 'c':
+        case 's':
+            if (packet.size() > 1 && sscanf(packet.data() + 1, "%x", &addr) == 1) {
+                vm.reg.pc = addr;
+            }
+            stop_requested = packet[0] == 's';
+            resumed = resume = true;
+            return "";
+        case 'Z':
+        case 'z':
+            // the length of a breakpoint is the instruction size, of a watchpoint the size of the watched range
+            if (sscanf(packet.data() + 1, "%u,%x,%x", &type, &addr, &len) != 3 || addr >= memory_size ||
+                (type >= 2 && !in_memory(addr, len))) {
+                return "E01";
+            }
+            if (type == 0 || type == 1) {
+                breakpoints.set(addr, packet[0] == 'Z');
+                return "OK";
+            }
+            if (type == 2) {
+                for (unsigned idx {}; idx < len; idx++) {
+                    watchpoints.set(addr + idx, packet[0] == 'Z');
+                }
+                return "OK";
+            }
+            return "";
+        case 'D':
+            send_packet("OK");
+            disconnect();
+            resume = true;
+            return "";
+        case 'k':
+            disconnect();
+            vm.gfx_obj.window.close();
+            resume = true;
+            return "";
+        case 'q':
+            if (packet.rfind("qSupported", 0) == 0) {
+                return "PacketSize=1000";
+            }
+            if (packet == "qAttached") {
+                return "1";
+            }
+            return "";
+        default:
+            return ""; // unsupported packet
+    }
+}
@@ -0,0 +1,63 @@
+#include "../include/Disassembler.hpp"
+#include <cstdio>
+
+std::string disassemble(const uint16_t instruction) {
+    const uint16_t nnn { static_cast<uint16_t>(instruction & 0x0fff) };
+    const uint8_t x  = (instruction & 0x0f00) >> 8,
+                  y  = (instruction & 0x00f0) >> 4,
+                  n  = instruction & 0x000f,
+                  kk = instruction & 0x00ff;
+    char buf[32] {};
+    switch ((instruction & 0xf000) >> 12) {
+        case 0x0:
+            if (instruction == 0x00e0) { return "CLS"; }
+            if (instruction == 0x00ee) { return "RET"; }
+            break;
+        case 0x1: snprintf(buf, sizeof(buf), "JP 0x%.3x", nnn); return buf;
+        case 0x2: snprintf(buf, sizeof(buf), "CALL 0x%.3x", nnn); return buf;
+        case 0x3: snprintf(buf, sizeof(buf), "SE V%X, 0x%.2x", x, kk); return buf;
+        case 0x4: snprintf(buf, sizeof(buf), "SNE V%X, 0x%.2x", x, kk); return buf;
+        case 0x5: snprintf(buf, sizeof(buf), "SE V%X, V%X", x, y); return buf;
+        case 0x6: snprintf(buf, sizeof(buf), "LD V%X, 0x%.2x", x, kk); return buf;
+        case 0x7: snprintf(buf, sizeof(buf), "ADD V%X, 0x%.2x", x, kk); return buf;
+        case 0x8:
+            switch (n) {
+                case 0x0: snprintf(buf, sizeof(buf), "LD V%X, V%X", x, y); return buf;
+                case 0x1: snprintf(buf, sizeof(buf), "OR V%X, V%X", x, y); return buf;
+                case 0x2: snprintf(buf, sizeof(buf), "AND V%X, V%X", x, y); return buf;
+                case 0x3: snprintf(buf, sizeof(buf), "XOR V%X, V%X", x, y); return buf;
+                case 0x4: snprintf(buf, sizeof(buf), "ADD V%X, V%X", x, y); return buf;
+                case 0x5: snprintf(buf, sizeof(buf), "SUB V%X, V%X", x, y); return buf;
+                case 0x6: snprintf(buf, sizeof(buf), "SHR V%X", x); return buf;
+                case 0x7: snprintf(buf, sizeof(buf), "SUBN V%X, V%X", x, y); return buf;
+                case 0xe: snprintf(buf, sizeof(buf), "SHL V%X", x); return buf;
+                default: break;
+            }
+            break;
+        case 0x9: snprintf(buf, sizeof(buf), "SNE V%X, V%X", x, y); return buf;
+        case 0xa: snprintf(buf, sizeof(buf), "LD I, 0x%.3x", nnn); return buf;
+        case 0xb: snprintf(buf, sizeof(buf), "JP V0, 0x%.3x", nnn); return buf;
+        case 0xc: snprintf(buf, sizeof(buf), "RND V%X, 0x%.2x", x, kk); return buf;
+        case 0xd: snprintf(buf, sizeof(buf), "DRW V%X, V%X, %u", x, y, n); return buf;
+        case 0xe:
+            if (kk == 0x9e) { snprintf(buf, sizeof(buf), "SKP V%X", x); return buf; }
+            if (kk == 0xa1) { snprintf(buf, sizeof(buf), "SKNP V%X", x); return buf; }
+            break;
+        case 0xf:
+            switch (kk) {
+                case 0x07: snprintf(buf, sizeof(buf), "LD V%X, DT", x); return buf;
+                case 0x0a: snprintf(buf, sizeof(buf), "LD V%X, K", x); return buf;
+                case 0x15: snprintf(buf, sizeof(buf), "LD DT, V%X", x); return buf;
+                case 0x18: snprintf(buf, sizeof(buf), "LD ST, V%X", x); return buf;
+                case 0x1e: snprintf(buf, sizeof(buf), "ADD I, V%X", x); return buf;
+                case 0x29: snprintf(buf, sizeof(buf), "LD F, V%X", x); return buf;
+                case 0x33: snprintf(buf, sizeof(buf), "LD B, V%X", x); return buf;
+                case 0x55: snprintf(buf, sizeof(buf), "LD [I], V%X", x); return buf;
+                case 0x65: snprintf(buf, sizeof(buf), "LD V%X, [I]", x); return buf;
+                default: break;
+            }
+            break;
+    }
+    snprintf(buf, sizeof(buf), "DW 0x%.4x", instruction);
+    return buf;
+}
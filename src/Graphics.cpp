@@ -1,11 +1,84 @@
 #include "../include/Graphics.hpp"
 #include <string>
+#include <utility>
 
-Graphics::Graphics(const uint8_t width, const uint8_t height, const uint8_t scale_factor, const std::string &title) 
+// the letters of the overlay labels the Chip-8 font lacks and the label separator, in the font layout (4x5, high nibble)
+static constexpr std::pair<char, std::array<uint8_t, 5>> label_glyphs[] {
+    { 'I', { 0xe0, 0x40, 0x40, 0x40, 0xe0 } },
+    { 'L', { 0x80, 0x80, 0x80, 0x80, 0xf0 } },
+    { 'O', { 0xf0, 0x90, 0x90, 0x90, 0xf0 } },
+    { 'P', { 0xe0, 0x90, 0xe0, 0x80, 0x80 } },
+    { 'R', { 0xe0, 0x90, 0xe0, 0xa0, 0x90 } },
+    { 'S', { 0xf0, 0x80, 0xf0, 0x10, 0xf0 } },
+    { 'T', { 0xe0, 0x40, 0x40, 0x40, 0x40 } },
+    { 'U', { 0x90, 0x90, 0x90, 0x90, 0xf0 } },
+    { ':', { 0x00, 0x40, 0x00, 0x40, 0x00 } }
+};
+
+Graphics::Graphics(const uint8_t width, const uint8_t height, const uint8_t scale_factor, const std::string &title, const ScaleFilter filter) 
     : window(sf::VideoMode(width * scale_factor, height * scale_factor), title.data()),
-      scale_factor(scale_factor) {
+      scale_factor(scale_factor),
+      upscaler(width, height, scale_factor, filter),
+      frame(width * height),
+      pixels(upscaler.out_width() * upscaler.out_height()),
+      overlay_font(nullptr) {
+        texture.create(upscaler.out_width(), upscaler.out_height());
+        sprite.setTexture(texture);
         // centralize the window
         auto desktop { sf::VideoMode::getDesktopMode() };
         window.setPosition(sf::Vector2i(desktop.width / 4, desktop.height / 4));
     }
 
+void Graphics::set_overlay(std::vector<std::string> lines, const uint8_t *font) noexcept {
+    overlay = std::move(lines);
+    overlay_font = font;
+}
+
+// every font pixel becomes a 2x2 block, the text is drawn in green on a black box
+void Graphics::draw_overlay() noexcept {
+    constexpr uint32_t text_color { 0xff00ff00 };
+    constexpr unsigned dot { 2 },
+                       advance { 5 * dot },
+                       line_height { 6 * dot },
+                       margin { 2 * dot };
+    const unsigned width { upscaler.out_width() },
+                   height { upscaler.out_height() };
+    size_t longest {};
+    for (const auto &line : overlay) {
+        longest = std::max(longest, line.size());
+    }
+    const unsigned box_width { std::min<unsigned>(width, margin * 2 + longest * advance) },
+                   box_height { std::min<unsigned>(height, margin * 2 + overlay.size() * line_height) };
+    for (unsigned row {}; row < box_height; row++) {
+        std::fill(pixels.begin() + row * width, pixels.begin() + row * width + box_width, Upscaler::pixel_off);
+    }
+    for (unsigned line {}; line < overlay.size(); line++) {
+        for (unsigned pos {}; pos < overlay[line].size(); pos++) {
+            const char c { overlay[line][pos] };
+            const uint8_t *glyph { c >= '0' && c <= '9' ? overlay_font + (c - '0') * 5 :
+                                   c >= 'A' && c <= 'F' ? overlay_font + (c - 'A' + 10) * 5 : nullptr };
+            for (const auto &[label_char, rows] : label_glyphs) {
+                if (c == label_char) {
+                    glyph = rows.data();
+                }
+            }
+            if (!glyph) {
+                continue; // e.g. a space
+            }
+            for (unsigned font_row {}; font_row < 5; font_row++) {
+                for (unsigned font_col {}; font_col < 4; font_col++) {
+                    if (!((glyph[font_row] >> (7 - font_col)) & 0x1u)) {
+                        continue;
+                    }
+                    const unsigned left { margin + pos * advance + font_col * dot },
+                                   top { margin + line * line_height + font_row * dot };
+                    for (unsigned y { top }; y < std::min(top + dot, box_height); y++) {
+                        for (unsigned x { left }; x < std::min(left + dot, box_width); x++) {
+                            pixels[y * width + x] = text_color;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
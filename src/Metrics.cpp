@@ -0,0 +1,146 @@
+#include "../include/Metrics.hpp"
+#include <cmath>
+#include <cstdio>
+
+using steady = std::chrono::steady_clock;
+using float_duration_s = std::chrono::duration<float>;
+
+void Histogram::observe(const float value_us) noexcept {
+    const uint64_t us { value_us > 0.f ? static_cast<uint64_t>(value_us) : 0 };
+    size_t bucket {};
+    while (bucket < bounds_us.size() && us > bounds_us[bucket]) {
+        bucket++;
+    }
+    metrics_add(buckets[bucket], 1);
+    metrics_add(sum_total_us, us);
+    metrics_add(count_total, 1);
+}
+
+void Histogram::write(std::string &out, const char *name, const char *help) const {
+    char line[160] {};
+    snprintf(line, sizeof(line), "# HELP %s_seconds %s\n# TYPE %s_seconds histogram\n", name, help, name);
+    out += line;
+    // the buckets are cumulative in the text format
+    uint64_t cumulative {};
+    for (size_t bucket {}; bucket < bounds_us.size(); bucket++) {
+        cumulative += buckets[bucket].load(std::memory_order_relaxed);
+        snprintf(line, sizeof(line), "%s_seconds_bucket{le=\"%g\"} %llu\n", name, bounds_us[bucket] / 1e6, static_cast<unsigned long long>(cumulative));
+        out += line;
+    }
+    cumulative += buckets.back().load(std::memory_order_relaxed);
+    snprintf(line, sizeof(line), "%s_seconds_bucket{le=\"+Inf\"} %llu\n%s_seconds_sum %g\n%s_seconds_count %llu\n",
+             name, static_cast<unsigned long long>(cumulative), name, sum_us() / 1e6, name, static_cast<unsigned long long>(count()));
+    out += line;
+}
+
+Metrics::Metrics()
+    : overlay_last { 0, 0, 0, 0, 0, 0, 0, steady::now() } {}
+
+Metrics::~Metrics() {
+    if (exporter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock { exporter_mutex };
+            exporter_stop = true;
+        }
+        exporter_cv.notify_one();
+        exporter.join();
+    }
+}
+
+void Metrics::start_export(const std::string &path) {
+    export_path = path;
+    exporter = std::thread(&Metrics::export_loop, this);
+}
+
+void Metrics::on_frame_presented(const float latency_us) noexcept {
+    metrics_add(frames_presented, 1);
+    frame_present.observe(latency_us);
+}
+
+void Metrics::on_sleep(const float overshoot_us) noexcept {
+    sleep_overshoot.observe(overshoot_us);
+}
+
+void Metrics::on_timers_tick(const float interval_us, const float period_us) noexcept {
+    timer_drift.observe(std::fabs(interval_us - period_us));
+    // a tick that comes half a period late or more has missed the frames in between
+    const float frames { std::round(interval_us / period_us) };
+    if (frames > 1.f) {
+        metrics_add(frames_dropped, static_cast<uint64_t>(frames) - 1);
+    }
+}
+
+std::vector<std::string> Metrics::overlay_lines() {
+    const auto now { steady::now() };
+    const uint64_t instructions_now { instructions.load(std::memory_order_relaxed) };
+    const float elapsed_s { float_duration_s(now - overlay_last.time).count() };
+    // mean of the observations since the previous call, 0 if there are none
+    auto mean = [](const Histogram &histogram, uint64_t &last_count, uint64_t &last_sum) {
+        const uint64_t count { histogram.count() }, sum { histogram.sum_us() };
+        const uint64_t mean_us { count > last_count ? (sum - last_sum) / (count - last_count) : 0 };
+        last_count = count;
+        last_sum = sum;
+        return mean_us;
+    };
+    // the labels use only the letters Graphics can draw
+    std::vector<std::string> lines {
+        "IPS:" + std::to_string(elapsed_s > 0.f ? static_cast<uint64_t>((instructions_now - overlay_last.instructions) / elapsed_s) : 0),
+        "PRES:" + std::to_string(mean(frame_present, overlay_last.present_count, overlay_last.present_sum)),
+        "SLEEP:" + std::to_string(mean(sleep_overshoot, overlay_last.sleep_count, overlay_last.sleep_sum)),
+        "DRIFT:" + std::to_string(mean(timer_drift, overlay_last.drift_count, overlay_last.drift_sum)),
+        "DROP:" + std::to_string(frames_dropped.load(std::memory_order_relaxed)),
+        "AUDIO:" + std::to_string(audio_restarts.load(std::memory_order_relaxed))
+    };
+    overlay_last.instructions = instructions_now;
+    overlay_last.time = now;
+    return lines;
+}
+
+void Metrics::export_loop() {
+    auto last_time { steady::now() };
+    uint64_t last_instructions { instructions.load(std::memory_order_relaxed) };
+    bool reported {};
+    std::unique_lock<std::mutex> lock { exporter_mutex };
+    while (!exporter_cv.wait_for(lock, std::chrono::seconds(1), [this] { return exporter_stop; })) {
+        const auto now { steady::now() };
+        const uint64_t instructions_now { instructions.load(std::memory_order_relaxed) };
+        const uint64_t ips { static_cast<uint64_t>((instructions_now - last_instructions) / float_duration_s(now - last_time).count()) };
+        last_time = now;
+        last_instructions = instructions_now;
+        if (!write_file(ips) && !reported) {
+            fprintf(stderr, "Cannot write the metrics to '%s'\n", export_path.data());
+            reported = true;
+        }
+    }
+}
+
+// the file is written next to the target and renamed over it, so scrapers never see a partial file
+bool Metrics::write_file(const uint64_t ips) const {
+    std::string out;
+    auto counter = [&out](const char *name, const char *type, const char *help, const uint64_t value) {
+        char line[256] {};
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, static_cast<unsigned long long>(value));
+        out += line;
+    };
+    counter("chip8_instructions_total", "counter", "Instructions emulated by the interpreter or translated blocks.", instructions.load(std::memory_order_relaxed));
+    counter("chip8_instructions_per_second", "gauge", "Instructions emulated per second over the last export period.", ips);
+    counter("chip8_cycles_skipped_total", "counter", "CPU cycles suspended in LD Vx, K or fast-forwarded in delay timer waits.", cycles_skipped.load(std::memory_order_relaxed));
+    counter("chip8_frames_presented_total", "counter", "Frames drawn to the window.", frames_presented.load(std::memory_order_relaxed));
+    counter("chip8_frames_dropped_total", "counter", "60 Hz frames missed because the host was late.", frames_dropped.load(std::memory_order_relaxed));
+    counter("chip8_audio_restarts_total", "counter", "Beeps restarted before the previous one finished.", audio_restarts.load(std::memory_order_relaxed));
+    frame_present.write(out, "chip8_frame_present", "Time to upscale and present a frame.");
+    sleep_overshoot.write(out, "chip8_sleep_overshoot", "Time slept beyond the requested pacing delay.");
+    timer_drift.write(out, "chip8_timer_drift", "Deviation of the 60 Hz timers updates from their period.");
+
+    const std::string tmp_path { export_path + ".tmp" };
+    FILE *file { fopen(tmp_path.data(), "w") };
+    if (!file) {
+        return false;
+    }
+    const bool written { fwrite(out.data(), 1, out.size(), file) == out.size() };
+    if (fclose(file) != 0 || !written) {
+        remove(tmp_path.data());
+        return false;
+    }
+    return rename(tmp_path.data(), export_path.data()) == 0;
+}
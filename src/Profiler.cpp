@@ -0,0 +1,116 @@
+#include "../include/Profiler.hpp"
+#include "../include/Disassembler.hpp"
+#include <algorithm>
+#include <cstdio>
+
+Profiler::Profiler()
+    : pc_hits(),
+      instruction_hits(0x10000),
+      pending_hits() {}
+
+void Profiler::flush_stack() {
+    if (pending_hits) {
+        stack_hits[frames] += pending_hits;
+        pending_hits = 0;
+    }
+}
+
+// sp is the stack pointer after CALL has pushed the return address
+void Profiler::on_call(const uint16_t target, const uint8_t sp) {
+    flush_stack();
+    frames.resize(sp - 1);
+    frames.push_back(target);
+}
+
+// sp is the stack pointer after RET has popped the return address
+void Profiler::on_return(const uint8_t sp) {
+    flush_stack();
+    frames.resize(sp);
+}
+
+// name of the interpreter routine executing the instruction, mirrors the jump tables of Chip8
+static std::string handler_name(const uint16_t instruction) {
+    static const char* const names[16] { "", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk",
+                                         "", "9xy0", "annn", "bnnn", "cxkk", "dxyn", "", "" };
+    const uint8_t opcode = instruction >> 12,
+                  n = instruction & 0x000f,
+                  kk = instruction & 0x00ff;
+    char buf[8] {};
+    switch (opcode) {
+        case 0x0: return n == 0x0 ? "00e0" : n == 0xe ? "00ee" : "invalid";
+        case 0x8:
+            if (n <= 0x7 || n == 0xe) {
+                snprintf(buf, sizeof(buf), "8xy%x", n);
+                return buf;
+            }
+            return "invalid";
+        case 0xe: return n == 0xe ? "ex9e" : n == 0x1 ? "exa1" : "invalid";
+        case 0xf:
+            switch (kk) {
+                case 0x07: case 0x0a: case 0x15: case 0x18: case 0x1e: case 0x29: case 0x33: case 0x55: case 0x65:
+                    snprintf(buf, sizeof(buf), "fx%.2x", kk);
+                    return buf;
+                default: return "invalid";
+            }
+        default: return names[opcode];
+    }
+}
+
+void Profiler::dump(const std::string &prefix, const uint8_t *memory) {
+    flush_stack();
+    const std::string folded_path { prefix + ".folded" },
+                      report_path { prefix + ".hot.txt" };
+    FILE *folded { fopen(folded_path.data(), "w") };
+    if (!folded) {
+        fprintf(stderr, "Cannot create '%s'\n", folded_path.data());
+        return;
+    }
+    for (const auto &[stack, hits] : stack_hits) {
+        fprintf(folded, "rom");
+        for (const uint16_t frame : stack) {
+            fprintf(folded, ";sub_%.3x", frame);
+        }
+        fprintf(folded, " %llu\n", static_cast<unsigned long long>(hits));
+    }
+    fclose(folded);
+
+    FILE *report { fopen(report_path.data(), "w") };
+    if (!report) {
+        fprintf(stderr, "Cannot create '%s'\n", report_path.data());
+        return;
+    }
+    uint64_t total {};
+    for (const uint64_t hits : pc_hits) {
+        total += hits;
+    }
+    const double percent { total ? 100.0 / total : 0.0 };
+    // hottest addresses, labeled with the current memory contents at that address
+    std::vector<uint16_t> hot_pcs;
+    for (uint16_t pc {}; pc < pc_hits.size(); pc++) {
+        if (pc_hits[pc]) {
+            hot_pcs.push_back(pc);
+        }
+    }
+    std::sort(hot_pcs.begin(), hot_pcs.end(), [this](const uint16_t a, const uint16_t b) { return pc_hits[a] > pc_hits[b]; });
+    fprintf(report, "%llu instructions executed\n\n%-8s %-12s %-8s %s\n", static_cast<unsigned long long>(total), "address", "count", "%", "instruction");
+    for (const uint16_t pc : hot_pcs) {
+        const uint16_t instruction = pc < pc_hits.size() - 1 ? (memory[pc] << 8) | memory[pc + 1] : memory[pc] << 8;
+        fprintf(report, "0x%.3x    %-12llu %-8.2f %s\n", pc, static_cast<unsigned long long>(pc_hits[pc]), pc_hits[pc] * percent,
+                                                          disassemble(instruction).data());
+    }
+    // executions per interpreter routine
+    std::map<std::string, uint64_t> handler_hits;
+    for (uint32_t instruction {}; instruction < instruction_hits.size(); instruction++) {
+        if (instruction_hits[instruction]) {
+            handler_hits[handler_name(instruction)] += instruction_hits[instruction];
+        }
+    }
+    std::vector<std::pair<std::string, uint64_t>> handlers { handler_hits.begin(), handler_hits.end() };
+    std::sort(handlers.begin(), handlers.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+    fprintf(report, "\n%-8s %-12s %s\n", "handler", "count", "%");
+    for (const auto &[name, hits] : handlers) {
+        fprintf(report, "%-8s %-12llu %.2f\n", name.data(), static_cast<unsigned long long>(hits), hits * percent);
+    }
+    fclose(report);
+    printf("Profile written to '%s' and '%s'\n", folded_path.data(), report_path.data());
+}
@@ -0,0 +1,76 @@
+#include "../include/RomPack.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+uint64_t rom_hash(const uint8_t *data, const size_t size) noexcept {
+    uint64_t hash { 0xcbf29ce484222325ull };
+    for (size_t idx {}; idx < size; idx++) {
+        hash = (hash ^ data[idx]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+RomPack::RomPack(const std::string &path_to_pack) {
+    const int fd { open(path_to_pack.data(), O_RDONLY) };
+    if (fd == -1) {
+        fprintf(stderr, "ROM pack '%s' is not found\n", path_to_pack.data());
+        exit(EXIT_FAILURE);
+    }
+    struct stat st {};
+    if (fstat(fd, &st) == -1) {
+        fprintf(stderr, "Cannot stat ROM pack '%s'\n", path_to_pack.data());
+        close(fd);
+        exit(EXIT_FAILURE);
+    }
+    length = st.st_size;
+    void *mapping { length ? mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED };
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Cannot map ROM pack '%s'\n", path_to_pack.data());
+        exit(EXIT_FAILURE);
+    }
+    base = static_cast<const uint8_t*>(mapping);
+    header = reinterpret_cast<const RomPackHeader*>(base);
+    entries = reinterpret_cast<const RomPackEntry*>(base + sizeof(RomPackHeader));
+    // validate the whole index once, lookups trust it afterwards
+    bool valid { length >= sizeof(RomPackHeader) &&
+                 !std::memcmp(header->magic, rom_pack_magic, sizeof(rom_pack_magic)) &&
+                 header->version == rom_pack_version &&
+                 header->rom_count <= (length - sizeof(RomPackHeader)) / sizeof(RomPackEntry) };
+    for (uint32_t idx {}; valid && idx < header->rom_count; idx++) {
+        const RomPackEntry &entry { entries[idx] };
+        valid = entry.name[rom_pack_name_size - 1] == '\0' &&
+                static_cast<size_t>(entry.offset) + entry.size <= length &&
+                (idx == 0 || std::strcmp(entries[idx - 1].name, entry.name) < 0);
+    }
+    if (!valid) {
+        fprintf(stderr, "'%s' is not a valid ROM pack\n", path_to_pack.data());
+        exit(EXIT_FAILURE);
+    }
+}
+
+RomPack::~RomPack() {
+    munmap(const_cast<uint8_t*>(base), length);
+}
+
+const RomPackEntry* RomPack::find(const std::string &name) const noexcept {
+    const RomPackEntry *end { entries + header->rom_count };
+    const RomPackEntry *entry { std::lower_bound(entries, end, name, [](const RomPackEntry &e, const std::string &key) {
+                                    return std::strcmp(e.name, key.data()) < 0;
+                                }) };
+    return entry != end && name == entry->name ? entry : nullptr;
+}
+
+const uint8_t* RomPack::image(const RomPackEntry &entry) const noexcept {
+    return base + entry.offset;
+}
+
+bool RomPack::intact(const RomPackEntry &entry) const noexcept {
+    return rom_hash(image(entry), entry.size) == entry.hash;
+}
@@ -0,0 +1,48 @@
+#include "../include/SharedFrame.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+SharedFrame::SharedFrame(const std::string &shm_name)
+    : name(shm_name.front() == '/' ? shm_name : "/" + shm_name) {
+    const int fd { shm_open(name.data(), O_CREAT | O_RDWR, 0600) };
+    if (fd == -1) {
+        fprintf(stderr, "Cannot create shared memory segment '%s'\n", name.data());
+        exit(EXIT_FAILURE);
+    }
+    void *mapping { ftruncate(fd, sizeof(SharedFrameLayout)) == 0
+                        ? mmap(nullptr, sizeof(SharedFrameLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                        : MAP_FAILED };
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Cannot map shared memory segment '%s'\n", name.data());
+        shm_unlink(name.data());
+        exit(EXIT_FAILURE);
+    }
+    layout = new (mapping) SharedFrameLayout {};
+    layout->magic = shared_frame_magic;
+    layout->version = shared_frame_version;
+}
+
+SharedFrame::~SharedFrame() {
+    munmap(layout, sizeof(SharedFrameLayout));
+    shm_unlink(name.data());
+}
+
+SharedFrameLayout& SharedFrame::begin_update() noexcept {
+    layout->sequence.store(layout->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return *layout;
+}
+
+void SharedFrame::end_update() noexcept {
+    layout->frame++;
+    layout->sequence.store(layout->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+uint16_t SharedFrame::input_keys() const noexcept {
+    return layout->input_keys.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,228 @@
+#include "../include/Upscaler.hpp"
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UPSCALER_X86
+#endif
+
+bool parse_scale_filter(const std::string &name, ScaleFilter &filter) {
+    static const std::pair<const char*, ScaleFilter> filters[] {
+        { "nearest", ScaleFilter::nearest },
+        { "scale2x", ScaleFilter::scale2x },
+        { "scale3x", ScaleFilter::scale3x },
+        { "smooth", ScaleFilter::smooth },
+        { "scanline", ScaleFilter::scanline }
+    };
+    for (const auto &[filter_name, value] : filters) {
+        if (name == filter_name) {
+            filter = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ===================== EXPANSION KERNELS =========================
+// Every grid pixel becomes a run of identical output pixels. Each run is filled with whole vector stores starting at the run,
+// the store that sticks out is overwritten by the next run (or lands in the slack at the end of the row buffer).
+
+static void expand_row_scalar(uint32_t *dst, const uint8_t *grid_row, const uint16_t *runs, const unsigned grid_width) noexcept {
+    for (unsigned col {}; col < grid_width; col++) {
+        std::fill(dst, dst + runs[col], grid_row[col] ? Upscaler::pixel_on : Upscaler::pixel_off);
+        dst += runs[col];
+    }
+}
+
+static void darken_row_scalar(uint32_t *dst, const uint32_t *src, const unsigned len) noexcept {
+    for (unsigned idx {}; idx < len; idx++) {
+        dst[idx] = ((src[idx] >> 1) & 0x007f7f7f) | (src[idx] & 0xff000000);
+    }
+}
+
+#ifdef UPSCALER_X86
+__attribute__((target("sse2")))
+static void expand_row_sse2(uint32_t *dst, const uint8_t *grid_row, const uint16_t *runs, const unsigned grid_width) noexcept {
+    const __m128i on { _mm_set1_epi32(static_cast<int>(Upscaler::pixel_on)) },
+                  off { _mm_set1_epi32(static_cast<int>(Upscaler::pixel_off)) };
+    for (unsigned col {}; col < grid_width; col++) {
+        const __m128i px { grid_row[col] ? on : off };
+        uint32_t *const run_end { dst + runs[col] };
+        for (; dst < run_end; dst += 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), px);
+        }
+        dst = run_end;
+    }
+}
+
+__attribute__((target("sse2")))
+static void darken_row_sse2(uint32_t *dst, const uint32_t *src, const unsigned len) noexcept {
+    const __m128i rgb_mask { _mm_set1_epi32(0x007f7f7f) },
+                  alpha_mask { _mm_set1_epi32(static_cast<int>(0xff000000)) };
+    unsigned idx {};
+    for (; idx + 4 <= len; idx += 4) {
+        const __m128i px { _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + idx)) };
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + idx),
+                         _mm_or_si128(_mm_and_si128(_mm_srli_epi32(px, 1), rgb_mask), _mm_and_si128(px, alpha_mask)));
+    }
+    darken_row_scalar(dst + idx, src + idx, len - idx);
+}
+
+__attribute__((target("avx2")))
+static void expand_row_avx2(uint32_t *dst, const uint8_t *grid_row, const uint16_t *runs, const unsigned grid_width) noexcept {
+    const __m256i on { _mm256_set1_epi32(static_cast<int>(Upscaler::pixel_on)) },
+                  off { _mm256_set1_epi32(static_cast<int>(Upscaler::pixel_off)) };
+    for (unsigned col {}; col < grid_width; col++) {
+        const __m256i px { grid_row[col] ? on : off };
+        uint32_t *const run_end { dst + runs[col] };
+        for (; dst < run_end; dst += 8) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), px);
+        }
+        dst = run_end;
+    }
+}
+
+__attribute__((target("avx2")))
+static void darken_row_avx2(uint32_t *dst, const uint32_t *src, const unsigned len) noexcept {
+    const __m256i rgb_mask { _mm256_set1_epi32(0x007f7f7f) },
+                  alpha_mask { _mm256_set1_epi32(static_cast<int>(0xff000000)) };
+    unsigned idx {};
+    for (; idx + 8 <= len; idx += 8) {
+        const __m256i px { _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + idx)) };
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + idx),
+                            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(px, 1), rgb_mask), _mm256_and_si256(px, alpha_mask)));
+    }
+    darken_row_scalar(dst + idx, src + idx, len - idx);
+}
+#endif
+
+// the best kernels the host CPU supports
+static const Upscaler::Kernels& select_kernels() noexcept {
+    static const Upscaler::Kernels scalar { "scalar", expand_row_scalar, darken_row_scalar };
+#ifdef UPSCALER_X86
+    static const Upscaler::Kernels sse2 { "sse2", expand_row_sse2, darken_row_sse2 },
+                                   avx2 { "avx2", expand_row_avx2, darken_row_avx2 };
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return sse2;
+    }
+#endif
+    return scalar;
+}
+
+// ===================== EDGE FILTERS ON THE INTERMEDIATE GRID =========================
+
+// Scale2x (EPX) : every source pixel becomes 2x2, the corners follow the diagonal edges of the neighbourhood
+static void scale2x(const uint8_t *src, uint8_t *dst, const unsigned w, const unsigned h) noexcept {
+    for (unsigned row {}; row < h; row++) {
+        for (unsigned col {}; col < w; col++) {
+            const uint8_t P { src[row * w + col] },
+                          A { src[(row ? row - 1 : row) * w + col] }, // up
+                          B { src[row * w + (col + 1 < w ? col + 1 : col)] }, // right
+                          C { src[row * w + (col ? col - 1 : col)] }, // left
+                          D { src[(row + 1 < h ? row + 1 : row) * w + col] }; // down
+            uint8_t *const out { dst + row * 2 * w * 2 + col * 2 };
+            out[0]         = (C == A && C != D && A != B) ? A : P;
+            out[1]         = (A == B && A != C && B != D) ? B : P;
+            out[w * 2]     = (D == C && D != B && C != A) ? C : P;
+            out[w * 2 + 1] = (B == D && B != A && D != C) ? D : P;
+        }
+    }
+}
+
+// Scale3x : every source pixel becomes 3x3
+static void scale3x(const uint8_t *src, uint8_t *dst, const unsigned w, const unsigned h) noexcept {
+    for (unsigned row {}; row < h; row++) {
+        const unsigned up { row ? row - 1 : row }, down { row + 1 < h ? row + 1 : row };
+        for (unsigned col {}; col < w; col++) {
+            const unsigned left { col ? col - 1 : col }, right { col + 1 < w ? col + 1 : col };
+            const uint8_t A { src[up * w + left] },   B { src[up * w + col] },   C { src[up * w + right] },
+                          D { src[row * w + left] },  E { src[row * w + col] },  F { src[row * w + right] },
+                          G { src[down * w + left] }, H { src[down * w + col] }, I { src[down * w + right] };
+            uint8_t *const out { dst + row * 3 * w * 3 + col * 3 };
+            const unsigned stride { w * 3 };
+            const bool db { D == B && B != F && D != H },
+                       bf { B == F && B != D && F != H },
+                       dh { D == H && D != B && H != F },
+                       hf { H == F && D != H && B != F };
+            out[0]              = db ? D : E;
+            out[1]              = (db && E != C) || (bf && E != A) ? B : E;
+            out[2]              = bf ? F : E;
+            out[stride]         = (db && E != G) || (dh && E != A) ? D : E;
+            out[stride + 1]     = E;
+            out[stride + 2]     = (bf && E != I) || (hf && E != C) ? F : E;
+            out[stride * 2]     = dh ? D : E;
+            out[stride * 2 + 1] = (dh && E != I) || (hf && E != G) ? H : E;
+            out[stride * 2 + 2] = hf ? F : E;
+        }
+    }
+}
+
+static unsigned grid_factor_of(const ScaleFilter filter, const unsigned scale) noexcept {
+    unsigned factor { 1 };
+    switch (filter) {
+        case ScaleFilter::scale2x: factor = 2; break;
+        case ScaleFilter::scale3x: factor = 3; break;
+        case ScaleFilter::smooth:  factor = 4; break;
+        default: break;
+    }
+    // the intermediate grid can't be finer than the window
+    return std::min(factor, scale);
+}
+
+Upscaler::Upscaler(const unsigned width, const unsigned height, const unsigned scale, const ScaleFilter filter)
+    : width(width),
+      height(height),
+      scale(scale),
+      filter(filter),
+      grid_factor(grid_factor_of(filter, scale)),
+      grid(width * grid_factor * height * grid_factor),
+      tmp_grid(width * 2 * height * 2),
+      col_runs(width * grid_factor),
+      row_runs(height * grid_factor),
+      row_buf(width * scale + 8),
+      kernels(select_kernels()) {
+    // grid pixel N covers the output pixels whose position maps to N, this spreads the remainder when scale isn't a multiple of the factor
+    for (unsigned out {}; out < width * scale; out++) {
+        col_runs[out * grid_factor / scale]++;
+    }
+    for (unsigned out {}; out < height * scale; out++) {
+        row_runs[out * grid_factor / scale]++;
+    }
+}
+
+const char* Upscaler::isa() const noexcept {
+    return kernels.isa;
+}
+
+inline void Upscaler::build_grid(const uint8_t *frame) noexcept {
+    switch (grid_factor) {
+        case 2: scale2x(frame, grid.data(), width, height); break;
+        case 3: scale3x(frame, grid.data(), width, height); break;
+        case 4:
+            scale2x(frame, tmp_grid.data(), width, height);
+            scale2x(tmp_grid.data(), grid.data(), width * 2, height * 2);
+            break;
+        default: std::copy(frame, frame + width * height, grid.begin()); break;
+    }
+}
+
+void Upscaler::upscale(const uint8_t *frame, uint32_t *out) noexcept {
+    build_grid(frame);
+    const unsigned grid_width { width * grid_factor },
+                   row_pixels { width * scale };
+    for (unsigned grid_row {}; grid_row < height * grid_factor; grid_row++) {
+        // expand the grid row once, then replicate it to all the output rows it covers
+        kernels.expand_row(row_buf.data(), grid.data() + grid_row * grid_width, col_runs.data(), grid_width);
+        for (unsigned rep {}; rep < row_runs[grid_row]; rep++) {
+            std::memcpy(out, row_buf.data(), row_pixels * sizeof(uint32_t));
+            out += row_pixels;
+        }
+        if (filter == ScaleFilter::scanline && row_runs[grid_row] > 1) {
+            kernels.darken_row(out - row_pixels, row_buf.data(), row_pixels);
+        }
+    }
+}
@@ -0,0 +1,149 @@
+#include "../include/VmPool.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+VmPool::VmPool(const uint8_t *rom_image, const size_t size)
+    : loaded_frame(nullptr) {
+    if (!scratch.load_image(rom_image, size)) {
+        fprintf(stderr, "ROM image is too large (%zu bytes)\nMaximum allowed ROM size is %d bytes\n", size, memory_size - 0x200);
+        exit(EXIT_FAILURE);
+    }
+    add_root_state();
+}
+
+VmPool::VmPool(const RomPack &rom_pack, const std::string &rom_name)
+    : loaded_frame(nullptr) {
+    if (!scratch.load_image(rom_pack, rom_name)) {
+        fprintf(stderr, "ROM '%s' is not found in the ROM pack, too large or corrupted\n", rom_name.data());
+        exit(EXIT_FAILURE);
+    }
+    add_root_state();
+}
+
+// the state loaded into the scratch VM becomes state 0
+void VmPool::add_root_state() {
+    State root; // every member is set below
+    for (uint8_t page {}; page < memory_page_count; page++) {
+        root.pages[page] = pages.acquire();
+        std::copy(scratch.memory.begin() + page * memory_page_size,
+                  scratch.memory.begin() + (page + 1) * memory_page_size,
+                  root.pages[page]->data.begin());
+        loaded_pages[page] = root.pages[page];
+    }
+    root.frame = frames.acquire();
+    root.frame->pixels = scratch.display;
+    loaded_frame = root.frame;
+    scratch.save_cpu_state(root.cpu);
+    states.push_back(root);
+}
+
+VmPool::vm_id VmPool::fork(const vm_id id) {
+    assert(live(id));
+    vm_id clone_id;
+    if (free_ids.empty()) {
+        clone_id = states.size();
+        states.emplace_back();
+    } else {
+        clone_id = free_ids.back();
+        free_ids.pop_back();
+    }
+    State &clone { states[clone_id] };
+    clone = states[id];
+    for (Page *page : clone.pages) {
+        pages.retain(page);
+    }
+    frames.retain(clone.frame);
+    return clone_id;
+}
+
+void VmPool::release(const vm_id id) {
+    assert(live(id)); // a second release would put the id into free_ids twice
+    State &state { states[id] };
+    for (Page *&page : state.pages) {
+        release_page(page);
+        page = nullptr;
+    }
+    release_frame(state.frame);
+    state.frame = nullptr;
+    free_ids.push_back(id);
+}
+
+// a freed block is handed out again with other contents, so the scratch VM must not take it for what it has loaded
+void VmPool::release_page(Page *page) {
+    if (pages.release(page)) {
+        std::replace(loaded_pages.begin(), loaded_pages.end(), static_cast<const Page*>(page), static_cast<const Page*>(nullptr));
+    }
+}
+
+void VmPool::release_frame(Frame *frame) {
+    if (frames.release(frame) && loaded_frame == frame) {
+        loaded_frame = nullptr;
+    }
+}
+
+Fault VmPool::run(const vm_id id, const unsigned cycles, const uint16_t keys) {
+    assert(live(id));
+    State &state { states[id] };
+    // materialize the state, states forked from the last one run differ in a few pages at most
+    for (uint8_t page {}; page < memory_page_count; page++) {
+        if (loaded_pages[page] != state.pages[page]) {
+            std::copy(state.pages[page]->data.begin(), state.pages[page]->data.end(), scratch.memory.begin() + page * memory_page_size);
+            loaded_pages[page] = state.pages[page];
+        }
+    }
+    if (loaded_frame != state.frame) {
+        scratch.display = state.frame->pixels;
+        loaded_frame = state.frame;
+    }
+    for (uint8_t key {}; key < keypad_size; key++) {
+        state.cpu.keypad[key] = (keys >> key) & 0x1u;
+    }
+    scratch.restore_cpu_state(state.cpu);
+    scratch.dirty_pages = 0;
+    scratch.display_dirty = false;
+
+    const Fault fault { scratch.run_cycles(cycles) };
+
+    // write back what has changed, blocks shared with other states are replaced by private copies
+    for (uint8_t page {}; page < memory_page_count; page++) {
+        if (!(scratch.dirty_pages & (1u << page))) {
+            continue;
+        }
+        Page *&target { state.pages[page] };
+        if (target->refs > 1) {
+            release_page(target);
+            target = pages.acquire();
+        }
+        std::copy(scratch.memory.begin() + page * memory_page_size,
+                  scratch.memory.begin() + (page + 1) * memory_page_size,
+                  target->data.begin());
+        loaded_pages[page] = target;
+    }
+    if (scratch.display_dirty) {
+        if (state.frame->refs > 1) {
+            release_frame(state.frame);
+            state.frame = frames.acquire();
+        }
+        state.frame->pixels = scratch.display;
+        loaded_frame = state.frame;
+    }
+    scratch.save_cpu_state(state.cpu);
+    return fault;
+}
+
+const Chip8::CpuState& VmPool::cpu_state(const vm_id id) const noexcept {
+    assert(live(id));
+    return states[id].cpu;
+}
+
+uint8_t VmPool::peek(const vm_id id, const uint16_t addr) const noexcept {
+    assert(live(id));
+    return states[id].pages[(addr % memory_size) / memory_page_size]->data[addr % memory_page_size];
+}
+
+const VmPool::Framebuffer& VmPool::display(const vm_id id) const noexcept {
+    assert(live(id));
+    return states[id].frame->pixels;
+}
@@ -6,7 +6,12 @@
 
 void usage_info(char** argv, FILE* stream) {
     fprintf(stream, "Usage : %s -r <path to ROM> -a <path to beep WAV file (or whatever sound effect)> " 
-                    "[-s <scale factor of the window, the default is 10 which emits 640x320 window>]\n", argv[0]);
+                    "[-s <scale factor of the window, the default is 10 which emits 640x320 window>] "
+                    "[-p <path to ROM pack built by chip8pack, -r is the ROM name inside of the pack then>] "
+                    "[-m <name of POSIX shared memory segment to export the frame to>] "
+                    "[-g <TCP port of the GDB stub, chip8vm built with CHIP8_DEBUGGER only>] "
+                    "[-f <upscaling filter : nearest (default), scale2x, scale3x, smooth, scanline>] "
+                    "[-M <path to Prometheus text file the runtime metrics are written to every second>]\n", argv[0]);
     if (stream == stderr) {
         exit(EXIT_FAILURE);
     }
@@ -22,10 +27,15 @@ bool is_uint(const std::string &str_arg) {
 // 0 - path to ROM
 // 1 - path to sound effect WAV file (beep)
 // 2 - window scale factor (default is x10 -> 640x320 window)
-std::tuple<std::string, std::string, unsigned> parse_args(int argc, char** argv) {
-    std::tuple<std::string, std::string, unsigned> args { std::make_tuple("", "", 10) };
+// 3 - path to ROM pack (empty if the ROM is loaded from a standalone file)
+// 4 - name of the shared memory segment the frame is exported to (empty - no export)
+// 5 - TCP port of the GDB stub (0 - no debugger)
+// 6 - upscaling filter (default is nearest)
+// 7 - path to the metrics file (empty - no export)
+std::tuple<std::string, std::string, unsigned, std::string, std::string, unsigned, ScaleFilter, std::string> parse_args(int argc, char** argv) {
+    std::tuple<std::string, std::string, unsigned, std::string, std::string, unsigned, ScaleFilter, std::string> args { std::make_tuple("", "", 10, "", "", 0, ScaleFilter::nearest, "") };
     int opt {};
-    while ((opt = getopt(argc, argv, "hr:a:s:")) != -1) {
+    while ((opt = getopt(argc, argv, "hr:a:s:p:m:g:f:M:")) != -1) {
         switch (opt) {
             case 'r': // -r option is for path to ROM
                 std::get<0>(args) = optarg; 
@@ -44,6 +54,27 @@ std::tuple<std::string, std::string, unsigned> parse_args(int argc, char** argv)
                     usage_info(argv, stderr);
                 }
                 break;
+            case 'p': // -p option is for path to ROM pack
+                std::get<3>(args) = optarg;
+                break;
+            case 'm': // -m option is for shared memory frame export
+                std::get<4>(args) = optarg;
+                break;
+            case 'g': // -g option is for GDB stub port
+                if (is_uint(optarg) && std::stoul(optarg) <= 65535) {
+                    std::get<5>(args) = std::stoul(optarg);
+                } else {
+                    usage_info(argv, stderr);
+                }
+                break;
+            case 'f': // -f option is for upscaling filter
+                if (!parse_scale_filter(optarg, std::get<6>(args))) {
+                    usage_info(argv, stderr);
+                }
+                break;
+            case 'M': // -M option is for runtime metrics export
+                std::get<7>(args) = optarg;
+                break;
             case 'h': // -h option is for help
                 if (argc == 2) {
                     usage_info(argv, stdout);
@@ -60,7 +91,7 @@ std::tuple<std::string, std::string, unsigned> parse_args(int argc, char** argv)
 }
 
 int main(int argc, char** argv) {
-    if (argc > 7) {
+    if (argc > 17) {
         usage_info(argv, stderr);
     }
     auto args_tup { parse_args(argc, argv) };
@@ -72,7 +103,23 @@ int main(int argc, char** argv) {
                                       " x " + 
                                       std::to_string(display_height * scale_factor) };
     
-    std::unique_ptr<Chip8> chip8_vm { std::make_unique<Chip8>(path_to_rom, path_to_sound, scale_factor, title) } ;
-    chip8_vm->run(); 
-    return 0;
+    // the pack stays mapped for the whole lifetime of the VM
+    std::unique_ptr<RomPack> rom_pack { std::get<3>(args_tup).empty() ? nullptr : std::make_unique<RomPack>(std::get<3>(args_tup)) };
+    std::unique_ptr<Chip8> chip8_vm { std::make_unique<Chip8>(path_to_rom, path_to_sound, scale_factor, title, std::get<6>(args_tup), rom_pack.get()) } ;
+    if (!std::get<4>(args_tup).empty()) {
+        chip8_vm->export_shared_frame(std::get<4>(args_tup));
+    }
+    if (!std::get<7>(args_tup).empty()) {
+        chip8_vm->export_metrics(std::get<7>(args_tup));
+    }
+    if (std::get<5>(args_tup)) {
+#ifdef CHIP8_DEBUGGER
+        chip8_vm->attach_debugger(std::get<5>(args_tup));
+#else
+        fprintf(stderr, "chip8vm is built without the debugger, reconfigure with -DCHIP8_DEBUGGER=ON\n");
+        exit(EXIT_FAILURE);
+#endif
+    }
+    // a malformed ROM has already been reported by run()
+    return chip8_vm->run() == Fault::none ? EXIT_SUCCESS : EXIT_FAILURE;
 }
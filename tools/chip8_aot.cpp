@@ -0,0 +1,218 @@
+// chip8aot - translates a Chip-8 ROM ahead-of-time into a C++ translation unit that is linked into chip8vm (see CHIP8_AOT_ROM in CMakeLists.txt)
+// The ROM is disassembled from its load address, the control flow graph is recovered by following jumps, calls, return sites
+// and both outcomes of skip instructions, and every discovered entry point becomes a block function.
+// Anything that cannot be resolved statically (JP V0, nnn, LD Vx, K, illegal instructions, self-modified code) is left to the interpreter.
+#include "../include/Disassembler.hpp"
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// blocks have no length limit, the emulator runs a block that spans a timers update in parts (see AotBlock in Aot.hpp)
+inline constexpr uint16_t memory_size   { 4096 },
+                          rom_load_addr { 0x200 };
+
+// result of translating a single instruction
+struct Translation {
+    std::string code; // C++ statements, empty if the instruction has to be left to the interpreter
+    bool ends_block; // the block is finished after this instruction
+    std::vector<uint16_t> successors; // statically known addresses the control flow continues at
+};
+
+struct Block {
+    uint16_t length;
+    std::string body; // one case per instruction, entered at the first instruction to run
+    std::string tail; // pc of the next instruction if the block doesn't transfer the control itself
+};
+
+std::string hex(const unsigned value) {
+    char buf[8] {};
+    snprintf(buf, sizeof(buf), "0x%x", value);
+    return buf;
+}
+
+// each emitted statement mirrors the corresponding inst_xxxx() interpreter routine with all the operands folded into constants
+Translation translate(const uint16_t addr, const uint16_t instruction) {
+    const uint16_t nnn { static_cast<uint16_t>(instruction & 0x0fff) },
+                   next { static_cast<uint16_t>(addr + 2) },
+                   skip { static_cast<uint16_t>(addr + 4) };
+    const std::string x  { hex((instruction & 0x0f00) >> 8) },
+                      y  { hex((instruction & 0x00f0) >> 4) },
+                      kk { hex(instruction & 0x00ff) },
+                      Vx { "vm.reg.V[" + x + "]" },
+                      Vy { "vm.reg.V[" + y + "]" },
+                      VF { "vm.reg.V[0xf]" };
+    // executes the instruction through the interpreter, used for instructions with side effects outside of the register file
+    const std::string interpret { "vm.reg.pc = " + hex(addr) + "; vm.aot_step();" },
+                      // the interpreter may fault (see Fault in Chip8.hpp), the block is left with pc at the faulting instruction
+                      interpret_checked { interpret + " if (vm.fault != Fault::none) { return; }" };
+    auto skip_if = [&](const std::string &cond) {
+        return Translation { "vm.reg.pc = (" + cond + ") ? " + hex(skip) + " : " + hex(next) + "; return;", true, { next, skip } };
+    };
+    auto op = [](const std::string &code) { return Translation { code, false, {} }; };
+    switch ((instruction & 0xf000) >> 12) {
+        case 0x0:
+            if (instruction == 0x00e0) { return op(interpret); }
+            if (instruction == 0x00ee) { return { interpret + " return;", true, {} }; }
+            break;
+        case 0x1: return { "vm.reg.pc = " + hex(nnn) + "; return;", true, { nnn } };
+        case 0x2: return { interpret + " return;", true, { nnn, next } };
+        case 0x3: return skip_if(Vx + " == " + kk);
+        case 0x4: return skip_if(Vx + " != " + kk);
+        case 0x5: return skip_if(Vx + " == " + Vy);
+        case 0x6: return op(Vx + " = " + kk + ";");
+        case 0x7: return op(Vx + " += " + kk + ";");
+        case 0x8:
+            switch (instruction & 0x000f) {
+                case 0x0: return op(Vx + " = " + Vy + ";");
+                case 0x1: return op(Vx + " |= " + Vy + ";");
+                case 0x2: return op(Vx + " &= " + Vy + ";");
+                case 0x3: return op(Vx + " ^= " + Vy + ";");
+                case 0x4: return op(VF + " = (" + Vx + " + " + Vy + ") > 255 ? 1 : 0; " + Vx + " = (" + Vx + " + " + Vy + ") & 0x00ff;");
+                case 0x5: return op(VF + " = " + Vx + " < " + Vy + " ? 0 : 1; " + Vx + " -= " + Vy + ";");
+                case 0x6: return op(VF + " = " + Vx + " & 0x1u; " + Vx + " >>= 1;");
+                case 0x7: return op(VF + " = " + Vx + " > " + Vy + " ? 0 : 1; " + Vx + " = " + Vy + " - " + Vx + ";");
+                case 0xe: return op(VF + " = " + Vx + " >> 7; " + Vx + " <<= 1;");
+                default: break;
+            }
+            break;
+        case 0x9: return skip_if(Vx + " != " + Vy);
+        case 0xa: return op("vm.reg.I = " + hex(nnn) + ";");
+        case 0xb: break; // indirect jump, the target is unknown until runtime
+        case 0xc: return op(interpret);
+        case 0xd: return op(interpret_checked);
+        case 0xe:
+            if ((instruction & 0x00ff) == 0x9e) { return skip_if("vm.keypad[" + Vx + " & 0xf]"); }
+            if ((instruction & 0x00ff) == 0xa1) { return skip_if("!vm.keypad[" + Vx + " & 0xf]"); }
+            break;
+        case 0xf:
+            switch (instruction & 0x00ff) {
+                case 0x07: return op(Vx + " = vm.timer.delay;");
+                case 0x0a: return { "", true, { next } }; // key wait stays in the interpreter
+                case 0x15: return op("vm.timer.delay = " + Vx + ";");
+                case 0x18: return op(interpret);
+                case 0x1e: return op(VF + " = (vm.reg.I + " + Vx + ") > 0xfff ? 1 : 0; vm.reg.I += " + Vx + ";");
+                case 0x29: return op("vm.reg.I = " + Vx + " * 5;");
+                // memory writes may hit translated code, so the block is finished right after them
+                case 0x33: return { interpret + " return;", true, { next } };
+                case 0x55: return { interpret + " return;", true, { next } };
+                case 0x65: {
+                    // a read past the end of memory is left to the interpreter, which reports the fault
+                    std::string code { "if (vm.reg.I + " + x + " + 1 > memory_size) { " + interpret + " return; } " };
+                    for (unsigned idx {}; idx <= ((instruction & 0x0f00u) >> 8); idx++) {
+                        code += "vm.reg.V[" + hex(idx) + "] = vm.memory[vm.reg.I + " + hex(idx) + "]; ";
+                    }
+                    return op(code + "if (vm.quirks & quirk_load_store_increments_i) { vm.reg.I += " + x + " + 1; }");
+                }
+                default: break;
+            }
+            break;
+    }
+    // illegal or non-canonical encodings are left to the interpreter, the control flow beyond them is unknown
+    return { "", true, {} };
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage : %s <path to ROM> <path to generated .cpp file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::ifstream rom_ifstream { argv[1], std::ios::binary };
+    if (!rom_ifstream) {
+        fprintf(stderr, "ROM '%s' is not found\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    const std::vector<uint8_t> rom { std::istreambuf_iterator<char>(rom_ifstream), std::istreambuf_iterator<char>() };
+    if (rom.size() > memory_size - rom_load_addr) {
+        fprintf(stderr, "'%s' is too large (%zu bytes)\n", argv[1], rom.size());
+        return EXIT_FAILURE;
+    }
+    const uint16_t rom_end { static_cast<uint16_t>(rom_load_addr + rom.size()) };
+    auto fetch = [&](const uint16_t addr) {
+        return static_cast<uint16_t>((rom[addr - rom_load_addr] << 8) | rom[addr - rom_load_addr + 1]);
+    };
+
+    // recover the control flow graph with a worklist, every reachable entry point becomes a block
+    std::map<uint16_t, Block> blocks;
+    std::set<uint16_t> visited;
+    std::vector<uint16_t> worklist { rom_load_addr };
+    while (!worklist.empty()) {
+        const uint16_t entry { worklist.back() };
+        worklist.pop_back();
+        if (!visited.insert(entry).second) {
+            continue;
+        }
+        Block block {};
+        uint16_t addr { entry };
+        bool terminated {};
+        while (true) {
+            // code outside of the ROM image (zero-filled memory) is left to the interpreter
+            if (addr < rom_load_addr || addr + 1 >= rom_end) {
+                break;
+            }
+            const uint16_t instruction { fetch(addr) };
+            Translation t { translate(addr, instruction) };
+            worklist.insert(worklist.end(), t.successors.begin(), t.successors.end());
+            if (t.code.empty()) {
+                break;
+            }
+            // the block is left before this instruction if it is the end of the requested range
+            if (block.length) {
+                block.body += "            if (last == " + std::to_string(block.length) + ") { vm.reg.pc = " + hex(addr) + "; return; }\n"
+                              "            [[fallthrough]];\n";
+            }
+            block.body += "        case " + std::to_string(block.length) + ":\n"
+                          "            // " + hex(addr) + " : " + disassemble(instruction) + "\n            " + t.code + "\n";
+            block.length++;
+            addr += 2;
+            if (t.ends_block) {
+                terminated = true;
+                break;
+            }
+        }
+        if (block.length) {
+            // a block that did not transfer the control itself continues at the next instruction (translated or interpreted)
+            if (!terminated) {
+                block.tail = "        vm.reg.pc = " + hex(addr) + ";\n";
+            }
+            blocks.emplace(entry, std::move(block));
+        }
+    }
+
+    FILE *out { fopen(argv[2], "w") };
+    if (!out) {
+        fprintf(stderr, "Cannot create '%s'\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "// generated by chip8aot from '%s' - do not edit\n", argv[1]);
+    fprintf(out, "#include \"Chip8.hpp\"\n#include \"Aot.hpp\"\n\n");
+    fprintf(out, "struct AotAccess {\n");
+    for (const auto &[entry, block] : blocks) {
+        fprintf(out, "    static void block_%.3x(Chip8 &vm, const unsigned first, [[maybe_unused]] const unsigned last) noexcept {\n"
+                     "        switch (first) {\n%s        }\n%s    }\n", entry, block.body.data(), block.tail.data());
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "const AotBlock aot_blocks[] = {\n");
+    for (const auto &[entry, block] : blocks) {
+        fprintf(out, "    { 0x%.3x, %u, &AotAccess::block_%.3x },\n", entry, block.length, entry);
+    }
+    if (blocks.empty()) {
+        fprintf(out, "    { 0, 0, nullptr }\n");
+    }
+    fprintf(out, "};\n");
+    fprintf(out, "const uint16_t aot_block_count { %zu };\n\n", blocks.size());
+    fprintf(out, "const uint8_t aot_rom_image[] = {");
+    for (size_t idx {}; idx < rom.size(); idx++) {
+        fprintf(out, "%s0x%.2x,", idx % 16 ? " " : "\n    ", rom[idx]);
+    }
+    fprintf(out, "%s};\n", rom.empty() ? "0" : "\n");
+    fprintf(out, "const uint16_t aot_rom_size { %zu };\n", rom.size());
+    fclose(out);
+    printf("%zu blocks translated from '%s'\n", blocks.size(), argv[1]);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+// chip8pack - builds a ROM pack (see include/RomPack.hpp) out of every regular file in a directory
+// Usage : chip8pack <ROM directory> <output pack> [<ROM name>=<quirks mask> ...]
+#include "../include/RomPack.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+inline constexpr size_t max_rom_size { 4096 - 0x200 };
+
+void usage_info(const char *program) {
+    fprintf(stderr, "Usage : %s <ROM directory> <output pack> [<ROM name>=<quirks mask> ...]\n"
+                    "The quirks mask is a decimal, hex (0x) or octal (0) number up to 0xff\n", program);
+}
+
+// parses a quirks mask, returns false unless the whole text is a number that fits into a byte
+bool parse_quirks(const std::string &text, uint8_t &mask) {
+    if (text.empty() || text[0] == '-' || text[0] == '+') {
+        return false;
+    }
+    char *end {};
+    errno = 0;
+    const unsigned long value { std::strtoul(text.data(), &end, 0) };
+    if (errno || *end != '\0' || value > 0xff) {
+        return false;
+    }
+    mask = static_cast<uint8_t>(value);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage_info(argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::map<std::string, uint8_t> quirks;
+    for (int idx { 3 }; idx < argc; idx++) {
+        const std::string arg { argv[idx] };
+        const size_t eq { arg.find('=') };
+        uint8_t mask {};
+        if (eq == std::string::npos || !parse_quirks(arg.substr(eq + 1), mask)) {
+            fprintf(stderr, "Invalid quirks argument '%s', expected <ROM name>=<quirks mask>\n", argv[idx]);
+            usage_info(argv[0]);
+            return EXIT_FAILURE;
+        }
+        quirks[arg.substr(0, eq)] = mask;
+    }
+    // std::map keeps the ROMs sorted by name, which is the index order RomPack::find() relies on
+    std::map<std::string, std::vector<uint8_t>> roms;
+    std::error_code ec;
+    for (const auto &dir_entry : std::filesystem::directory_iterator(argv[1], ec)) {
+        if (!dir_entry.is_regular_file()) {
+            continue;
+        }
+        const std::string name { dir_entry.path().filename().string() };
+        std::ifstream rom_ifstream { dir_entry.path(), std::ios::binary };
+        std::vector<uint8_t> image { std::istreambuf_iterator<char>(rom_ifstream), std::istreambuf_iterator<char>() };
+        if (name.size() >= rom_pack_name_size || image.size() > max_rom_size) {
+            fprintf(stderr, "Skipping '%s' : the name must be shorter than %zu characters and the ROM at most %zu bytes\n",
+                    name.data(), rom_pack_name_size, max_rom_size);
+            continue;
+        }
+        roms.emplace(name, std::move(image));
+    }
+    if (ec) {
+        fprintf(stderr, "Cannot read directory '%s' : %s\n", argv[1], ec.message().data());
+        return EXIT_FAILURE;
+    }
+
+    RomPackHeader header {};
+    std::memcpy(header.magic, rom_pack_magic, sizeof(header.magic));
+    header.version = rom_pack_version;
+    header.rom_count = roms.size();
+    std::vector<RomPackEntry> entries;
+    uint32_t offset = sizeof(RomPackHeader) + roms.size() * sizeof(RomPackEntry);
+    for (const auto &[name, image] : roms) {
+        RomPackEntry entry {};
+        std::strncpy(entry.name, name.data(), rom_pack_name_size - 1);
+        entry.hash = rom_hash(image.data(), image.size());
+        entry.offset = offset;
+        entry.size = image.size();
+        if (auto it { quirks.find(name) }; it != quirks.end()) {
+            entry.quirks = it->second;
+            quirks.erase(it);
+        }
+        entries.push_back(entry);
+        offset += image.size();
+    }
+    for (const auto &[name, mask] : quirks) {
+        fprintf(stderr, "Warning : quirks given for '%s' which is not in the pack\n", name.data());
+    }
+
+    std::ofstream pack { argv[2], std::ios::binary };
+    pack.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pack.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(RomPackEntry));
+    for (const auto &[name, image] : roms) {
+        pack.write(reinterpret_cast<const char*>(image.data()), image.size());
+    }
+    if (!pack) {
+        fprintf(stderr, "Cannot write '%s'\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    printf("%zu ROMs packed into '%s' (%u bytes)\n", roms.size(), argv[2], offset);
+    return EXIT_SUCCESS;
+}